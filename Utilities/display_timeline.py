@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+# display_timeline.py
+# Host side model of the snowy family frame transfer timeline.
+# Works out how long a frame takes to go out over SPI6 when each column
+# is converted then sent (serial), versus converting the next column
+# while the current one is still on the wire (ping-pong staging).
+#
+# RebbleOS
+
+import argparse
+
+PLATFORMS = {
+    # lines sent per frame, bytes per line
+    'snowy': (144, 168),
+    'chalk': (180, 180),
+}
+
+
+def serial_frame(lines, convert_us, dma_us, isr_us):
+    """ Convert, send, wait for completion, repeat """
+    t = 0.0
+    events = []
+    for line in range(lines):
+        events.append((t, 'convert', line))
+        t += convert_us
+        events.append((t, 'dma', line))
+        t += dma_us + isr_us
+    return t, events
+
+
+def pingpong_frame(lines, convert_us, dma_us, isr_us):
+    """ Two lines are staged up front, after that each completion
+        starts the staged line and converts the next one behind it """
+    t = 0.0
+    events = []
+    staged = min(2, lines)
+    for line in range(staged):
+        events.append((t, 'convert', line))
+        t += convert_us
+    for line in range(lines):
+        events.append((t, 'dma', line))
+        wire_done = t + dma_us
+        if 0 < line < lines - 1:
+            # conversion of line + 1 runs in the ISR alongside the wire
+            events.append((t, 'convert', line + 1))
+            t = max(wire_done, t + convert_us)
+        else:
+            t = wire_done
+        t += isr_us
+    return t, events
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Model snowy display frame transfer time')
+    parser.add_argument('--platform', choices=PLATFORMS.keys(), default='snowy')
+    parser.add_argument('--cpu-mhz', type=float, default=168.0)
+    parser.add_argument('--spi-mhz', type=float, default=84.0 / 8,
+                        help='SPI6 clock, APB2 / prescaler')
+    parser.add_argument('--convert-cycles', type=float, default=12.0,
+                        help='cpu cycles spent converting one output byte')
+    parser.add_argument('--isr-us', type=float, default=2.0,
+                        help='completion ISR and DMA restart overhead per line')
+    parser.add_argument('--trace', action='store_true', help='print every event')
+    args = parser.parse_args()
+
+    lines, line_bytes = PLATFORMS[args.platform]
+    convert_us = line_bytes * args.convert_cycles / args.cpu_mhz
+    dma_us = line_bytes * 8 / args.spi_mhz
+
+    before, before_events = serial_frame(lines, convert_us, dma_us, args.isr_us)
+    after, after_events = pingpong_frame(lines, convert_us, dma_us, args.isr_us)
+
+    if args.trace:
+        for name, events in (('serial', before_events), ('ping-pong', after_events)):
+            print('# %s' % name)
+            for t, kind, line in events:
+                print('%10.1f us  %-8s line %d' % (t, kind, line))
+
+    print('%s: %d lines of %d bytes' % (args.platform, lines, line_bytes))
+    print('  convert %.1f us/line, wire %.1f us/line' % (convert_us, dma_us))
+    print('  serial    %8.1f us/frame (%.1f fps max)' % (before, 1e6 / before))
+    print('  ping-pong %8.1f us/frame (%.1f fps max)' % (after, 1e6 / after))
+    print('  saved     %8.1f us/frame (%.1f%%)' % (before - after, 100.0 * (before - after) / before))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,282 @@
+/* aa_test.c
+ * Golden image tests and timings for neographics' antialiased 1px lines
+ * and circles.
+ *
+ *   aa_test [-u] [-b]
+ *
+ * Each scene is drawn into a snowy framebuffer and compared byte for byte
+ * with golden/aa_<scene>.raw. On a mismatch the render and the golden are
+ * written to build/ as PPMs to look at. -u rewrites the goldens instead,
+ * do that only for a change that is meant to alter the output, and look
+ * at the PPMs first. -b also times each primitive with antialiasing off
+ * and on.
+ * RebbleOS
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "context.h"
+#include "common.h"
+#include "primitives/line.h"
+#include "primitives/circle.h"
+#include "path/path.h"
+
+#define WIDTH __SCREEN_WIDTH
+#define HEIGHT __SCREEN_HEIGHT
+#define FRAME_SIZE (WIDTH * HEIGHT)
+#define BENCH_CALLS 100000
+
+#define WHITE ((n_GColor) { .argb = 0b11111111 })
+#define BLACK ((n_GColor) { .argb = 0b11000000 })
+#define RED ((n_GColor) { .argb = 0b11110000 })
+#define BLUE ((n_GColor) { .argb = 0b11000011 })
+
+static uint8_t _frame[FRAME_SIZE] __attribute__((aligned(4)));
+static uint8_t _golden[FRAME_SIZE] __attribute__((aligned(4)));
+
+static void _clear(n_GContext *ctx, uint8_t argb)
+{
+    memset(_frame, argb, sizeof(_frame));
+    n_graphics_context_reset_clip(ctx);
+    n_graphics_context_set_antialiased(ctx, true);
+    n_graphics_context_set_stroke_width(ctx, 1);
+}
+
+/* a fan of every slope from a point, end points walk round the edges */
+static void _scene_lines(n_GContext *ctx)
+{
+    _clear(ctx, WHITE.argb);
+    n_graphics_context_set_stroke_color(ctx, BLACK);
+
+    for (int16_t x = 4; x < WIDTH; x += 9)
+    {
+        n_graphics_draw_line(ctx, n_GPoint(72, 84), n_GPoint(x, 2));
+        n_graphics_draw_line(ctx, n_GPoint(72, 84), n_GPoint(WIDTH - 1 - x, HEIGHT - 3));
+    }
+    for (int16_t y = 4; y < HEIGHT; y += 9)
+    {
+        n_graphics_draw_line(ctx, n_GPoint(72, 84), n_GPoint(2, y));
+        n_graphics_draw_line(ctx, n_GPoint(72, 84), n_GPoint(WIDTH - 3, HEIGHT - 1 - y));
+    }
+}
+
+static void _scene_circles(n_GContext *ctx)
+{
+    _clear(ctx, WHITE.argb);
+    n_graphics_context_set_stroke_color(ctx, BLACK);
+
+    for (uint16_t r = 1; r < 70; r += 6)
+        n_graphics_draw_circle(ctx, n_GPoint(72, 84), r);
+
+    n_graphics_context_set_stroke_color(ctx, RED);
+    n_graphics_draw_circle(ctx, n_GPoint(20, 20), 3);
+    n_graphics_draw_circle(ctx, n_GPoint(124, 20), 8);
+    n_graphics_draw_circle(ctx, n_GPoint(20, 148), 14);
+    n_graphics_draw_circle(ctx, n_GPoint(124, 148), 1);
+}
+
+/* colored background, translucent strokes, clipped and off screen */
+static void _scene_mixed(n_GContext *ctx)
+{
+    n_GPoint star[5] = { {72, 10}, {100, 90}, {30, 40}, {114, 40}, {44, 90} };
+
+    _clear(ctx, BLUE.argb);
+    n_graphics_context_set_stroke_color(ctx, WHITE);
+    n_graphics_draw_path(ctx, 5, star, false);
+
+    n_graphics_context_set_stroke_color(ctx, (n_GColor) { .argb = 0b10111100 });
+    for (int16_t i = -40; i < 200; i += 13)
+        n_graphics_draw_line(ctx, n_GPoint(i, -20), n_GPoint(i - 60, 190));
+
+    n_graphics_context_push_clip(ctx, n_GRect(20, 100, 100, 50));
+    n_graphics_context_set_stroke_color(ctx, RED);
+    n_graphics_draw_circle(ctx, n_GPoint(70, 125), 40);
+    n_graphics_draw_circle(ctx, n_GPoint(0, 100), 30);
+    n_graphics_context_pop_clip(ctx);
+
+    n_graphics_context_set_stroke_color(ctx, (n_GColor) { .argb = 0b01110000 });
+    n_graphics_draw_circle(ctx, n_GPoint(140, 160), 25);
+}
+
+static const struct {
+    const char *name;
+    void (*draw)(n_GContext *ctx);
+} _scenes[] = {
+    { "lines", _scene_lines },
+    { "circles", _scene_circles },
+    { "mixed", _scene_mixed },
+};
+
+static void _write_ppm(const char *path, const uint8_t *frame)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (!f)
+        return;
+
+    fprintf(f, "P6 %d %d 255\n", WIDTH, HEIGHT);
+    for (int i = 0; i < FRAME_SIZE; i++)
+    {
+        fputc(((frame[i] >> 4) & 3) * 85, f);
+        fputc(((frame[i] >> 2) & 3) * 85, f);
+        fputc((frame[i] & 3) * 85, f);
+    }
+    fclose(f);
+}
+
+static int _check_scene(n_GContext *ctx, int i, int update)
+{
+    char path[64];
+    FILE *f;
+    int differ = 0;
+
+    _scenes[i].draw(ctx);
+    snprintf(path, sizeof(path), "golden/aa_%s.raw", _scenes[i].name);
+
+    if (update)
+    {
+        f = fopen(path, "wb");
+        if (!f || fwrite(_frame, 1, sizeof(_frame), f) != sizeof(_frame))
+        {
+            printf("FAIL %s: can't write %s\n", _scenes[i].name, path);
+            return 1;
+        }
+        fclose(f);
+        printf("updated %s\n", path);
+        return 0;
+    }
+
+    f = fopen(path, "rb");
+    if (!f || fread(_golden, 1, sizeof(_golden), f) != sizeof(_golden))
+    {
+        printf("FAIL %s: can't read %s\n", _scenes[i].name, path);
+        return 1;
+    }
+    fclose(f);
+
+    for (int p = 0; p < FRAME_SIZE; p++)
+        differ += _frame[p] != _golden[p];
+
+    if (!differ)
+        return 0;
+
+    printf("FAIL %s: %d pixels differ from %s\n", _scenes[i].name, differ, path);
+    snprintf(path, sizeof(path), "build/aa_%s.ppm", _scenes[i].name);
+    _write_ppm(path, _frame);
+    snprintf(path, sizeof(path), "build/aa_%s_golden.ppm", _scenes[i].name);
+    _write_ppm(path, _golden);
+    return 1;
+}
+
+/*
+ * Wu's lines split each step's coverage over the two pixels straddling
+ * the line, so every column of a shallow line should add up to about one
+ * full pixel, three steps of the four argb2222 can show
+ */
+static int _check_coverage(n_GContext *ctx)
+{
+    int bad = 0;
+
+    _clear(ctx, BLACK.argb);
+    n_graphics_context_set_stroke_color(ctx, WHITE);
+    n_graphics_draw_line(ctx, n_GPoint(5, 10), n_GPoint(130, 47));
+
+    for (int16_t x = 5; x <= 130; x++)
+    {
+        int sum = 0;
+
+        for (int16_t y = 0; y < HEIGHT; y++)
+            sum += _frame[y * WIDTH + x] & 3;
+        bad += sum < 2 || sum > 4;
+    }
+
+    if (bad)
+        printf("FAIL coverage: %d columns out of range\n", bad);
+    return bad != 0;
+}
+
+static double _now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void _draw_bench(n_GContext *ctx, int kind)
+{
+    static n_GPoint tri[3] = { {10, 10}, {130, 60}, {40, 150} };
+
+    switch (kind)
+    {
+        case 0: n_graphics_draw_line(ctx, n_GPoint(3, 7), n_GPoint(140, 90)); break;
+        case 1: n_graphics_draw_line(ctx, n_GPoint(10, 160), n_GPoint(40, 5)); break;
+        case 2: n_graphics_draw_circle(ctx, n_GPoint(72, 84), 10); break;
+        case 3: n_graphics_draw_circle(ctx, n_GPoint(72, 84), 40); break;
+        case 4: n_graphics_draw_path(ctx, 3, tri, false); break;
+    }
+}
+
+/*
+ * Host timings, only good for comparing the two modes and spotting
+ * regressions. The watch is a lot slower, and not always by the same factor
+ */
+static void _bench(n_GContext *ctx)
+{
+    static const char *names[] = {
+        "line, shallow", "line, steep", "circle r10", "circle r40", "triangle outline",
+    };
+    double us[2];
+
+    printf("%-18s %10s %10s\n", "per call", "aa off", "aa on");
+    for (int kind = 0; kind < 5; kind++)
+    {
+        for (int aa = 0; aa < 2; aa++)
+        {
+            double start;
+
+            _clear(ctx, WHITE.argb);
+            n_graphics_context_set_antialiased(ctx, aa);
+            n_graphics_context_set_stroke_color(ctx, BLACK);
+
+            start = _now_us();
+            for (int i = 0; i < BENCH_CALLS; i++)
+                _draw_bench(ctx, kind);
+            us[aa] = (_now_us() - start) / BENCH_CALLS;
+        }
+        printf("%-18s %8.3fus %8.3fus  %.2fx\n", names[kind], us[0], us[1], us[1] / us[0]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    n_GContext *ctx = n_graphics_context_from_buffer(_frame);
+    int update = 0, bench = 0, failures = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-u"))
+            update = 1;
+        else if (!strcmp(argv[i], "-b"))
+            bench = 1;
+    }
+
+    for (uint32_t i = 0; i < sizeof(_scenes) / sizeof(_scenes[0]); i++)
+        failures += _check_scene(ctx, i, update);
+    failures += _check_coverage(ctx);
+
+    if (failures)
+    {
+        printf("aa: %d FAILED\n", failures);
+        return 1;
+    }
+    printf("aa: ok\n");
+
+    if (bench)
+        _bench(ctx);
+
+    n_graphics_context_destroy(ctx);
+    return 0;
+}
@@ -0,0 +1,220 @@
+/* native_test.c
+ * Checks that drawing straight into the display's native layout
+ * (DISPLAY_NATIVE_FRAMEBUFFER) puts the same bytes on the wire as drawing
+ * into the normal framebuffer and converting it with scanline_convert_range.
+ *
+ *   native_test out.bin
+ *
+ * Draws the same seeded run of random primitives either way, and after
+ * every round writes what would go to the FPGA to out.bin. The Makefile
+ * builds it with and without DISPLAY_NATIVE_FRAMEBUFFER and compares the
+ * two files. The native build also checks scanline_convert_rows_native,
+ * used for the splash screen, against scanline_convert_range, and
+ * scanline_native_get_row, used for snapshots, against the rows it started from.
+ * RebbleOS
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snowy_display.h"
+#include "context.h"
+#include "common.h"
+#include "deferred/deferred.h"
+#include "primitives/line.h"
+#include "primitives/circle.h"
+#include "primitives/rect.h"
+#include "path/path.h"
+
+#define ROUNDS 60
+#define OPS_PER_ROUND 40
+#define FRAME_SIZE (DISPLAY_ROWS * DISPLAY_COLS)
+
+static uint8_t _frame[FRAME_SIZE] __attribute__((aligned(4)));
+#if !defined(DISPLAY_NATIVE_FRAMEBUFFER)
+static uint8_t _wire[FRAME_SIZE] __attribute__((aligned(4)));
+#endif
+
+static int16_t _coord(int16_t size)
+{
+    // mostly on screen, some way off it
+    return rand() % (size + 80) - 40;
+}
+
+static n_GPoint _point(void)
+{
+    return n_GPoint(_coord(DISPLAY_COLS), _coord(DISPLAY_ROWS));
+}
+
+static n_GRect _rect(void)
+{
+    return n_GRect(_coord(DISPLAY_COLS), _coord(DISPLAY_ROWS), rand() % 100, rand() % 100);
+}
+
+static n_GColor _color(void)
+{
+    // half of them opaque, the rest any alpha
+    n_GColor c = { .argb = rand() };
+
+    if (rand() % 2)
+        c.argb |= 0b11000000;
+    return c;
+}
+
+static void _draw_one(n_GContext *ctx)
+{
+    n_GPoint points[6];
+    uint32_t num_points;
+
+    n_graphics_context_set_stroke_color(ctx, _color());
+    n_graphics_context_set_fill_color(ctx, _color());
+    n_graphics_context_set_antialiased(ctx, rand() % 2);
+    n_graphics_context_set_stroke_caps(ctx, rand() % 2);
+    n_graphics_context_set_stroke_width(ctx, 1 + rand() % 8);
+
+    switch (rand() % 10)
+    {
+        case 0:
+            // pixels aren't clipped, callers keep them on screen
+            n_graphics_draw_pixel(ctx, n_GPoint(rand() % DISPLAY_COLS, rand() % DISPLAY_ROWS));
+            break;
+        case 1:
+        case 2:
+            n_graphics_draw_line(ctx, _point(), _point());
+            break;
+        case 3:
+            n_graphics_fill_rect(ctx, _rect(), rand() % 12, rand() % 16);
+            break;
+        case 4:
+            n_graphics_draw_rect(ctx, _rect(), rand() % 12, rand() % 16);
+            break;
+        case 5:
+            n_graphics_fill_circle(ctx, _point(), rand() % 60);
+            break;
+        case 6:
+            n_graphics_draw_circle(ctx, _point(), rand() % 60);
+            break;
+        case 7:
+            n_graphics_draw_arc(ctx, _rect(), n_GOvalScaleModeFitCircle,
+                                rand() % TRIG_MAX_ANGLE, rand() % (2 * TRIG_MAX_ANGLE));
+            break;
+        case 8:
+        case 9:
+            num_points = 3 + rand() % 4;
+            for (uint32_t i = 0; i < num_points; i++)
+                points[i] = _point();
+            if (rand() % 2)
+                n_graphics_fill_path(ctx, num_points, points);
+            else
+                n_graphics_draw_path(ctx, num_points, points, rand() % 2);
+            break;
+    }
+}
+
+/* what goes out to the FPGA for the whole frame */
+static uint8_t *_wire_bytes(void)
+{
+#if defined(DISPLAY_NATIVE_FRAMEBUFFER)
+    return _frame;
+#else
+    scanline_convert_range(_wire, _frame, 0, DISPLAY_COLS);
+    return _wire;
+#endif
+}
+
+#if defined(DISPLAY_NATIVE_FRAMEBUFFER)
+/* the splash screen is converted a row pair at a time straight from flash */
+static int _check_splash(void)
+{
+    static uint8_t rows[FRAME_SIZE] __attribute__((aligned(4)));
+    static uint8_t want[FRAME_SIZE] __attribute__((aligned(4)));
+
+    for (int f = 0; f < 20; f++)
+    {
+        for (uint32_t i = 0; i < sizeof(rows); i++)
+            rows[i] = rand();
+
+        scanline_convert_range(want, rows, 0, DISPLAY_COLS);
+        for (uint16_t y = 0; y < DISPLAY_ROWS; y += 2)
+            scanline_convert_rows_native(_frame, rows + y * DISPLAY_COLS, y);
+
+        if (memcmp(want, _frame, sizeof(want)))
+        {
+            printf("FAIL splash: scanline_convert_rows_native differs, frame %d\n", f);
+            return 1;
+        }
+        
+        // and back again, as snapshots read it
+        for (uint16_t y = 0; y < DISPLAY_ROWS; y++)
+        {
+            scanline_native_get_row(want, _frame, y);
+            for (uint16_t x = 0; x < DISPLAY_COLS; x++)
+            {
+                if (want[x] != (rows[y * DISPLAY_COLS + x] | 0b11000000))
+                {
+                    printf("FAIL snapshot: scanline_native_get_row row %d pixel %d, frame %d\n", y, x, f);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    n_GContext *ctx;
+    FILE *out;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s out.bin\n", argv[0]);
+        return 2;
+    }
+
+    out = fopen(argv[1], "wb");
+    if (!out)
+    {
+        perror(argv[1]);
+        return 2;
+    }
+
+    srand(1);
+
+    // start from an opaque frame, the native layout has no alpha to keep
+    ctx = n_graphics_context_from_buffer(_frame);
+    for (int16_t y = 0; y < DISPLAY_ROWS; y++)
+        for (int16_t x = 0; x < DISPLAY_COLS; x++)
+            n_graphics_set_pixel(ctx, n_GPoint(x, y), (n_GColor) { .argb = 0b11000000 | rand() });
+    fwrite(_wire_bytes(), 1, FRAME_SIZE, out);
+
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        // every third round through the band renderer
+        uint8_t deferred = r % 3 == 2 && n_graphics_context_begin_deferred(ctx);
+
+        if (rand() % 2)
+            n_graphics_context_push_clip(ctx, _rect());
+
+        for (int i = 0; i < OPS_PER_ROUND; i++)
+            _draw_one(ctx);
+
+        if (deferred)
+            n_graphics_context_end_deferred(ctx);
+        n_graphics_context_reset_clip(ctx);
+
+        fwrite(_wire_bytes(), 1, FRAME_SIZE, out);
+    }
+
+    fclose(out);
+    n_graphics_context_destroy(ctx);
+
+#if defined(DISPLAY_NATIVE_FRAMEBUFFER)
+    if (_check_splash())
+        return 1;
+#endif
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+/* neographics_host.c
+ * What neographics needs from the firmware, for the host tests
+ * RebbleOS
+ */
+
+#include <math.h>
+#include "pebble.h"
+
+int32_t sin_lookup(int32_t angle)
+{
+    return lround(sin(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle)
+{
+    return lround(cos(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+/* tests draw straight into a buffer, there is nothing to capture */
+GBitmap *graphics_capture_frame_buffer(void *ctx)
+{
+    return NULL;
+}
+
+GBitmap *graphics_capture_frame_buffer_format(void *ctx, GBitmapFormat format)
+{
+    return NULL;
+}
+
+bool graphics_release_frame_buffer(void *ctx, GBitmap *bitmap)
+{
+    return false;
+}
@@ -0,0 +1,71 @@
+/* scanline_baseline.c
+ * The byte at a time scanline converters from before they were reworked
+ * to convert a word at a time (hw/platform/snowy_family/snowy_scanlines.c).
+ * Kept as the reference the current ones are checked against. Do not
+ * "fix" anything in here
+ * RebbleOS
+ *
+ * Author: Barry Carter <barry.carter@gmail.com>
+ */
+
+#include <stdint.h>
+#include "platform.h"
+#include "scanline_test.h"
+
+void baseline_convert_row(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t row_index)
+{
+    uint8_t r0_fullbyte, r1_fullbyte, lsb, msb;
+    uint32_t row_offset = row_index * DISPLAY_COLS;
+
+    for (uint16_t xi = 0; xi < DISPLAY_COLS; xi+=2)
+    {
+        r1_fullbyte = frame_buffer[row_offset + xi];
+        r0_fullbyte = frame_buffer[row_offset + xi + 1];
+        
+        lsb = (r0_fullbyte & (0b00101010)) >> 1 | (r1_fullbyte & (0b00101010));
+        msb = (r0_fullbyte & (0b00010101)) | (r1_fullbyte & (0b00010101)) << 1;
+            
+        out_buffer[xi/2] = lsb;
+        out_buffer[(xi/2) + DISPLAY_COLS / 2] = msb;
+    }
+}
+
+void baseline_convert_column(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t column_index)
+{
+    int i = 0;
+    uint16_t pos_half_lsb = 0;
+    uint16_t pos_half_msb = 0;
+    
+    uint16_t y;
+    uint8_t r0_fullbyte, r1_fullbyte, lsb, msb;
+    uint16_t halfrows = DISPLAY_ROWS / 2;
+    
+    for (uint16_t yi = 0; yi < DISPLAY_ROWS; yi+=2)
+    {
+        y = DISPLAY_ROWS - 1 - yi;
+        uint16_t halfy = y / 2;
+
+        pos_half_lsb = halfy;
+        pos_half_msb = halfrows + halfy;
+        
+        r0_fullbyte = frame_buffer[column_index + i];
+        r1_fullbyte = frame_buffer[column_index + i + DISPLAY_COLS];
+        
+        lsb = (r0_fullbyte & (0b00101010)) >> 1 | (r1_fullbyte & (0b00101010));
+        msb = (r0_fullbyte & (0b00010101)) | (r1_fullbyte & (0b00010101)) << 1;
+        
+        out_buffer[pos_half_lsb] = lsb;
+        out_buffer[pos_half_msb] = msb;
+
+        i += 2 * DISPLAY_COLS;
+    }
+}
+
+void baseline_convert(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t index)
+{
+#if defined(REBBLE_PLATFORM_CHALK)
+    baseline_convert_row(out_buffer, frame_buffer, index);
+#else
+    baseline_convert_column(out_buffer, frame_buffer, index);
+#endif
+}
@@ -0,0 +1,291 @@
+/* scanline_test.c
+ * Checks the scanline converters in hw/platform/snowy_family/snowy_scanlines.c
+ * are bit exact with the byte at a time ones they replaced
+ * (scanline_baseline.c), and times the two.
+ *
+ *   scanline_test [-b] [frame.raw ...]
+ *
+ * Every run checks random frames and a set of made up ones (flat, stripes,
+ * checkers, gradients, sparse). Any raw frames given are checked as well,
+ * these are DISPLAY_COLS x DISPLAY_ROWS bytes of framebuffer as written by
+ * Utilities/snapshot_decode.py --raw. -b also runs the benchmark.
+ * RebbleOS
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "snowy_display.h"
+#include "scanline_test.h"
+
+#define RANDOM_FRAMES 200
+#define RANGES_PER_FRAME 16
+#define BENCH_FRAMES 2000
+
+static uint8_t _frame[TEST_FRAME_SIZE] __attribute__((aligned(4)));
+static uint8_t _want[TEST_LINES * DISPLAY_LINE_LENGTH] __attribute__((aligned(4)));
+static uint8_t _got[TEST_LINES * DISPLAY_LINE_LENGTH] __attribute__((aligned(4)));
+static int _failures;
+
+/*
+ * Can the converter skip byte i of a line? Only chalk skips anything,
+ * the pixels of each row that fall outside the round display
+ */
+static int _skippable(uint16_t line, uint16_t i)
+{
+#if defined(PBL_ROUND)
+    /* each byte holds a pixel pair, one plane in each half of the line */
+    uint16_t x = (i % (DISPLAY_COLS / 2)) * 2;
+    uint8_t inset = display_row_inset[line];
+
+    return x + 1 < inset || x > DISPLAY_COLS - 1 - inset;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Convert lines first to first + count - 1 both ways and compare.
+ * Everything the baseline wrote in range has to match, and nothing
+ * outside the range may be written at all
+ */
+static void _check_range(const char *name, uint8_t first, uint8_t count)
+{
+    for (uint16_t l = 0; l < TEST_LINES; l++)
+        baseline_convert(_want + l * DISPLAY_LINE_LENGTH, _frame, l);
+
+    /* start from the inverse so anything left alone stands out */
+    for (uint32_t i = 0; i < sizeof(_got); i++)
+        _got[i] = ~_want[i];
+
+    scanline_convert_range(_got, _frame, first, count);
+
+    for (uint16_t l = 0; l < TEST_LINES; l++)
+    {
+        uint8_t in_range = l >= first && l < first + count;
+
+        for (uint16_t i = 0; i < DISPLAY_LINE_LENGTH; i++)
+        {
+            uint32_t at = l * DISPLAY_LINE_LENGTH + i;
+            uint8_t want = _want[at], untouched = ~want;
+            uint8_t ok;
+
+            if (!in_range)
+                ok = _got[at] == untouched;
+            else if (_skippable(l, i))
+                ok = _got[at] == want || _got[at] == untouched;
+            else
+                ok = _got[at] == want;
+
+            if (!ok)
+            {
+                printf("FAIL %s: lines %d+%d, line %d byte %d is %02x, want %02x\n",
+                       name, first, count, l, i, _got[at], _want[at]);
+                _failures++;
+                return;
+            }
+        }
+    }
+}
+
+/* scanline_convert one line at a time, as the per line DMA mode does */
+static void _check_single(const char *name)
+{
+    static uint8_t line[DISPLAY_LINE_LENGTH] __attribute__((aligned(4)));
+
+    for (uint16_t l = 0; l < TEST_LINES; l++)
+    {
+        baseline_convert(_want, _frame, l);
+        for (uint16_t i = 0; i < DISPLAY_LINE_LENGTH; i++)
+            line[i] = ~_want[i];
+
+        scanline_convert(line, _frame, l);
+
+        for (uint16_t i = 0; i < DISPLAY_LINE_LENGTH; i++)
+        {
+            uint8_t untouched = ~_want[i];
+
+            if (line[i] != _want[i] && !(_skippable(l, i) && line[i] == untouched))
+            {
+                printf("FAIL %s: scanline_convert line %d byte %d is %02x, want %02x\n",
+                       name, l, i, line[i], _want[i]);
+                _failures++;
+                return;
+            }
+        }
+    }
+}
+
+static void _check_frame(const char *name)
+{
+    _check_range(name, 0, TEST_LINES);
+    _check_single(name);
+
+    for (int i = 0; i < RANGES_PER_FRAME; i++)
+    {
+        uint8_t first = rand() % TEST_LINES;
+        uint8_t count = 1 + rand() % (TEST_LINES - first);
+
+        _check_range(name, first, count);
+    }
+}
+
+static void _check_made_up(void)
+{
+    static const struct { const char *name; int kind; uint8_t a, b; } frames[] = {
+        { "black",       0, 0xC0, 0 },
+        { "white",       0, 0xFF, 0 },
+        { "red",         0, 0xF0, 0 },
+        { "rows",        1, 0xFF, 0xC0 },
+        { "columns",     2, 0xFF, 0xC0 },
+        { "checkers",    3, 0xEA, 0xD5 },
+        { "gradient",    4, 0, 0 },
+        { "sparse",      5, 0xFF, 0 },
+    };
+
+    for (uint32_t f = 0; f < sizeof(frames) / sizeof(frames[0]); f++)
+    {
+        for (uint16_t y = 0; y < DISPLAY_ROWS; y++)
+        {
+            for (uint16_t x = 0; x < DISPLAY_COLS; x++)
+            {
+                uint8_t *p = &_frame[y * DISPLAY_COLS + x];
+
+                switch (frames[f].kind)
+                {
+                    case 0: *p = frames[f].a; break;
+                    case 1: *p = y & 1 ? frames[f].b : frames[f].a; break;
+                    case 2: *p = x & 1 ? frames[f].b : frames[f].a; break;
+                    case 3: *p = (x ^ y) & 1 ? frames[f].b : frames[f].a; break;
+                    case 4: *p = 0xC0 | ((x + y) & 0x3F); break;
+                    case 5: *p = rand() % 64 ? frames[f].a : rand(); break;
+                }
+            }
+        }
+
+        _check_frame(frames[f].name);
+    }
+}
+
+static void _check_random(void)
+{
+    char name[32];
+
+    for (int f = 0; f < RANDOM_FRAMES; f++)
+    {
+        for (uint32_t i = 0; i < sizeof(_frame); i++)
+            _frame[i] = rand();
+
+        snprintf(name, sizeof(name), "random %d", f);
+        _check_frame(name);
+    }
+}
+
+static void _check_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    long size;
+
+    if (!f)
+    {
+        printf("FAIL %s: can't open\n", path);
+        _failures++;
+        return;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+
+    /* frames from the other platform are fine, just not for this build */
+    if (size != TEST_FRAME_SIZE)
+    {
+        printf("skipped %s: %ld bytes, not a %dx%d frame\n", path, size, DISPLAY_COLS, DISPLAY_ROWS);
+        fclose(f);
+        return;
+    }
+
+    if (fread(_frame, 1, sizeof(_frame), f) != sizeof(_frame))
+    {
+        printf("FAIL %s: short read\n", path);
+        _failures++;
+    }
+    else
+    {
+        _check_frame(path);
+    }
+
+    fclose(f);
+}
+
+static double _now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/*
+ * Whole frame, the way the display driver converts it. Host numbers only
+ * say which way things moved, the Cortex-M4 is what actually matters
+ */
+static void _bench(void)
+{
+    double start, baseline, current;
+
+    for (uint32_t i = 0; i < sizeof(_frame); i++)
+        _frame[i] = rand();
+
+    start = _now_us();
+    for (int f = 0; f < BENCH_FRAMES; f++)
+    {
+        for (uint16_t l = 0; l < TEST_LINES; l++)
+            baseline_convert(_want + l * DISPLAY_LINE_LENGTH, _frame, l);
+        __asm__ volatile("" : : "r"(_want) : "memory");
+    }
+    baseline = (_now_us() - start) / BENCH_FRAMES;
+
+    start = _now_us();
+    for (int f = 0; f < BENCH_FRAMES; f++)
+    {
+        scanline_convert_range(_got, _frame, 0, TEST_LINES);
+        __asm__ volatile("" : : "r"(_got) : "memory");
+    }
+    current = (_now_us() - start) / BENCH_FRAMES;
+
+    printf("frame convert: baseline %.2f us, current %.2f us (%.2fx)\n",
+           baseline, current, baseline / current);
+}
+
+int main(int argc, char **argv)
+{
+    int bench = 0;
+
+    srand(1);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-b"))
+            bench = 1;
+        else
+            _check_file(argv[i]);
+    }
+
+    _check_made_up();
+    _check_random();
+
+    if (_failures)
+    {
+        printf("scanline: %d FAILED\n", _failures);
+        return 1;
+    }
+
+    printf("scanline: ok\n");
+
+    if (bench)
+        _bench();
+
+    return 0;
+}
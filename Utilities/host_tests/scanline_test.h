@@ -0,0 +1,21 @@
+#pragma once
+/* scanline_test.h
+ * Bits shared by the host scanline tests
+ * RebbleOS
+ */
+
+#include <stdint.h>
+
+#if defined(REBBLE_PLATFORM_CHALK)
+/* the FPGA takes rows on chalk, columns on snowy */
+#define TEST_LINES DISPLAY_ROWS
+#else
+#define TEST_LINES DISPLAY_COLS
+#endif
+
+#define TEST_FRAME_SIZE (DISPLAY_ROWS * DISPLAY_COLS)
+
+/* scanline_baseline.c */
+void baseline_convert_row(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t row_index);
+void baseline_convert_column(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t column_index);
+void baseline_convert(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t index);
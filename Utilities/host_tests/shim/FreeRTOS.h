@@ -0,0 +1,5 @@
+#pragma once
+/* Host stand-in for FreeRTOS.h, the code under test only needs the types */
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
@@ -0,0 +1,2 @@
+#pragma once
+/* Host stand-in for rcore/display.h. Nothing from it is used on the host */
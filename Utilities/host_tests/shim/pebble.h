@@ -0,0 +1,27 @@
+#pragma once
+/* Host stand-in for the SDK's pebble.h, just what neographics uses */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef struct GBitmap GBitmap;
+typedef struct GContext GContext;
+typedef int GBitmapFormat;
+
+#define GPoint(x, y) ((n_GPoint) {x, y})
+
+#define TRIG_MAX_RATIO 0x10000
+#define TRIG_MAX_ANGLE 0x10000
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+
+/* the app heap is the host's */
+#define app_malloc malloc
+#define app_free free
+
+/* neographics_host.c. The firmware passes the context itself in */
+GBitmap *graphics_capture_frame_buffer(void *ctx);
+GBitmap *graphics_capture_frame_buffer_format(void *ctx, GBitmapFormat format);
+bool graphics_release_frame_buffer(void *ctx, GBitmap *bitmap);
@@ -0,0 +1,21 @@
+#pragma once
+/* platform.h
+ * Host stand-in for hw/platform/<platform>/platform.h. Just the display
+ * geometry, matching the platform's platform_config.h
+ * RebbleOS
+ */
+
+#include <stdint.h>
+
+#if defined(REBBLE_PLATFORM_CHALK)
+#define DISPLAY_ROWS 180
+#define DISPLAY_COLS 180
+#define PBL_ROUND
+/* pulled out of hw/platform/chalk/chalk.c by the Makefile */
+extern const uint8_t display_row_inset[DISPLAY_ROWS];
+#elif defined(REBBLE_PLATFORM_SNOWY)
+#define DISPLAY_ROWS 168
+#define DISPLAY_COLS 144
+#else
+#error "Build with -DREBBLE_PLATFORM_SNOWY or -DREBBLE_PLATFORM_CHALK"
+#endif
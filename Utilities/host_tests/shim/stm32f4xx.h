@@ -0,0 +1,3 @@
+#pragma once
+/* Host stand-in for the STM32 peripheral headers */
+typedef struct GPIO_TypeDef GPIO_TypeDef;
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+# snapshot_decode.py
+# Turn display snapshots from the debug serial log into PNGs.
+# See display_snapshot in rcore/display.c for the format. Other log
+# lines are ignored, so a raw capture of the debug port works as is.
+#
+# RebbleOS
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+
+def unrle(data):
+    """ Undo _snapshot_rle """
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        c = data[i]
+        i += 1
+        if c < 0x80:
+            out += data[i:i + c + 1]
+            i += c + 1
+        else:
+            out += bytes([data[i]]) * (c - 0x80 + 2)
+            i += 1
+    return out
+
+
+def to_rgb(rows, width, bpp):
+    """ Framebuffer rows to RGB scanlines """
+    lines = []
+    for row in rows:
+        line = bytearray()
+        for x in range(width):
+            if bpp == 1:
+                v = 255 if row[x // 8] >> (x % 8) & 1 else 0
+                line += bytes((v, v, v))
+            else:
+                # argb2222, alpha dropped
+                p = row[x]
+                line += bytes((((p >> 4) & 3) * 85, ((p >> 2) & 3) * 85, (p & 3) * 85))
+        lines.append(bytes(line))
+    return lines
+
+
+def write_png(path, width, lines):
+    def chunk(kind, data):
+        body = kind + data
+        return struct.pack('>I', len(data)) + body + struct.pack('>I', zlib.crc32(body) & 0xFFFFFFFF)
+
+    raw = b''.join(b'\0' + line for line in lines)
+    with open(path, 'wb') as f:
+        f.write(b'\x89PNG\r\n\x1a\n')
+        f.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, len(lines), 8, 2, 0, 0, 0)))
+        f.write(chunk(b'IDAT', zlib.compress(raw, 9)))
+        f.write(chunk(b'IEND', b''))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode display snapshots from a debug log')
+    parser.add_argument('log', nargs='?', help='captured log, stdin if not given')
+    parser.add_argument('-o', '--outdir', default='.', help='where to write the PNGs')
+    parser.add_argument('--prefix', default='snapshot')
+    parser.add_argument('--raw', action='store_true',
+                        help='also write the framebuffer bytes as is, for Utilities/host_tests')
+    args = parser.parse_args()
+
+    src = open(args.log, 'r', errors='replace') if args.log else sys.stdin
+    rows = None
+    header = None
+    written = 0
+
+    for line in src:
+        # the tag may follow other junk on a line
+        at = line.find('@')
+        if at < 0:
+            continue
+        fields = line[at:].split()
+        tag = fields[0]
+
+        if tag == '@S' and len(fields) == 7:
+            seq, width, height, row_bytes, bpp, key = map(int, fields[1:])
+            if rows is None or key or len(rows) != height or len(rows[0]) != row_bytes:
+                if not key:
+                    print('snapshot %d: delta with no keyframe, starting blank' % seq, file=sys.stderr)
+                rows = [bytes(row_bytes)] * height
+            header = (seq, width, bpp)
+        elif tag == '@R' and len(fields) == 3 and header:
+            y = int(fields[1])
+            data = unrle(bytes.fromhex(fields[2]))
+            if y < len(rows) and len(data) == len(rows[y]):
+                rows[y] = bytes(data)
+            else:
+                print('snapshot %d: bad row %d' % (header[0], y), file=sys.stderr)
+        elif tag == '@E' and header:
+            seq, width, bpp = header
+            path = os.path.join(args.outdir, '%s_%05d.png' % (args.prefix, seq))
+            write_png(path, width, to_rgb(rows, width, bpp))
+            if args.raw:
+                with open(path[:-len('.png')] + '.raw', 'wb') as raw:
+                    raw.write(b''.join(rows))
+            written += 1
+            header = None
+
+    print('wrote %d snapshots' % written)
+
+
+if __name__ == '__main__':
+    main()
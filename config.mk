@@ -4,6 +4,7 @@ CFLAGS_all += -IFreeRTOS/include
 CFLAGS_all += -IFreeRTOS/portable/GCC/ARM_CM4F
 CFLAGS_all += -IPlatform/CMSIS/Include
 CFLAGS_all += -Ilib/neographics/src/
+CFLAGS_all += -Ilib/neographics/src/deferred
 CFLAGS_all += -Ilib/neographics/src/draw_command
 CFLAGS_all += -Ilib/neographics/src/path
 CFLAGS_all += -Ilib/neographics/src/primitives
@@ -62,6 +63,7 @@ SRCS_all += lib/musl/time/__month_to_secs.c
 
 SRCS_all += lib/neographics/src/common.c
 SRCS_all += lib/neographics/src/context.c
+SRCS_all += lib/neographics/src/deferred/deferred.c
 SRCS_all += lib/neographics/src/draw_command/draw_command.c
 SRCS_all += lib/neographics/src/fonts/fonts.c
 SRCS_all += lib/neographics/src/path/path.c
@@ -12,6 +12,7 @@
 #include "stdio.h"
 #include "string.h"
 #include "chalk.h"
+#include "platform_config.h"
 #include "display.h"
 #include "log.h"
 #include "stm32_power.h"
@@ -60,6 +61,27 @@ void platform_init_late()
     printf("Relocating NVIC to 0x08004000\n");
 }
 
+/* Round display geometry.
+ * Number of pixels at each end of a row that sit outside the 180 pixel
+ * circle. Row y is visible from display_row_inset[y] up to
+ * DISPLAY_COLS - 1 - display_row_inset[y]. A pixel counts as visible if
+ * any part of it falls inside the circle. The circle is symmetric so the
+ * same table also gives the visible span of each column */
+const uint8_t display_row_inset[DISPLAY_ROWS] = {
+    76, 71, 66, 63, 60, 57, 55, 52, 50, 48, 46, 45, 43, 41, 40,
+    38, 37, 35, 34, 33, 32, 31, 29, 28, 27, 26, 25, 24, 23, 22,
+    22, 21, 20, 19, 18, 17, 17, 16, 15, 15, 14, 13, 13, 12, 12,
+    11, 10, 10,  9,  9,  8,  8,  7,  7,  7,  6,  6,  5,  5,  5,
+     4,  4,  4,  3,  3,  3,  2,  2,  2,  2,  2,  1,  1,  1,  1,
+     1,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,
+     1,  1,  1,  1,  2,  2,  2,  2,  2,  3,  3,  3,  4,  4,  4,
+     5,  5,  5,  6,  6,  7,  7,  7,  8,  8,  9,  9, 10, 10, 11,
+    12, 12, 13, 13, 14, 15, 15, 16, 17, 17, 18, 19, 20, 21, 22,
+    22, 23, 24, 25, 26, 27, 28, 29, 31, 32, 33, 34, 35, 37, 38,
+    40, 41, 43, 45, 46, 48, 50, 52, 55, 57, 60, 63, 66, 71, 76
+};
+
 /* Snowy platform button definitions */
 stm32_button_t platform_buttons[HW_BUTTON_MAX] = {
     [HW_BUTTON_BACK]   = { GPIO_Pin_4, GPIOG, EXTI_PortSourceGPIOG, EXTI_PinSource4, RCC_AHB1Periph_GPIOG, EXTI4_IRQn },
@@ -11,6 +11,10 @@
 #define DISPLAY_ROWS 180
 #define DISPLAY_COLS 180
 
+/* Chalk has a round display, see chalk.c for the visible span of each row */
+#define PBL_ROUND
+extern const uint8_t display_row_inset[DISPLAY_ROWS];
+
 extern unsigned char _binary_Resources_chalk_fpga_bin_size;
 extern unsigned char _binary_Resources_chalk_fpga_bin_start;
 #define DISPLAY_FPGA_ADDR &_binary_Resources_chalk_fpga_bin_start
@@ -14,6 +14,11 @@
 //We are a square device
 #define PBL_RECT
 
+// Have neographics draw straight into the FPGA's column/bit plane layout,
+// so frames go out without a conversion pass. Anything that pokes the
+// framebuffer directly will see that layout too, so it is off by default
+// #define DISPLAY_NATIVE_FRAMEBUFFER
+
 extern unsigned char _binary_Resources_snowy_fpga_bin_size;
 extern unsigned char _binary_Resources_snowy_fpga_bin_start;
 #define DISPLAY_FPGA_ADDR &_binary_Resources_snowy_fpga_bin_start
@@ -22,15 +22,57 @@
 
 #define ROW_LENGTH    DISPLAY_COLS
 #define COLUMN_LENGTH DISPLAY_ROWS
-static uint8_t _column_buffer[COLUMN_LENGTH];
+/* Two staging buffers. While one column is on the wire, the next is
+ * converted into the other one */
+static uint8_t _column_buffer[2][COLUMN_LENGTH] __attribute__((aligned(4)));
 static uint8_t _display_ready;
 
-void _snowy_display_start_frame(uint8_t xoffset, uint8_t yoffset);
+/* Per frame timing, see display_stat_record */
+static uint32_t _frame_dma_start;
+static uint32_t _frame_convert_us;
+static uint32_t _frame_isrs;
+
+#ifdef SNOWY_DISPLAY_FRAME_DMA
+/* The frame being sent, and how much of it has gone */
+static uint8_t *_native_frame;
+static uint32_t _native_sent;
+#ifndef DISPLAY_NATIVE_FRAMEBUFFER
+/* The whole frame, already in the FPGA's line order */
+static uint8_t _native_buffer[MAX_FRAMEBUFFER_SIZE] __attribute__((aligned(4)));
+/* Cleared when the native buffer no longer matches what is on screen */
+static uint8_t _native_valid;
+
+/* A hash of each group of lines as it was last converted, so lines
+ * that were redrawn the same as before can be left alone. Four
+ * columns share a word on snowy, so they are hashed together */
+#if defined(REBBLE_PLATFORM_CHALK)
+#define HASH_LINES 1
+#else
+#define HASH_LINES 4
+#endif
+#define HASH_GROUPS (ROW_LENGTH / HASH_LINES)
+static uint32_t _line_hash[HASH_GROUPS];
+
+/* A hash can still collide, so every so often convert the whole frame
+ * anyway. That bounds how long a stale line could stay on screen */
+#define SNOWY_DISPLAY_FULL_CONVERT_FRAMES 64
+static uint8_t _frames_since_full;
+#endif
+#endif
+
+/* FPGA image upload. The image goes out over DMA straight from flash
+ * while we get on with the rest of the display init */
+static const uint8_t *_fpga_blob;
+static uint32_t _fpga_remaining;
+static uint32_t _fpga_upload_start;
+
+void _snowy_display_start_frame(uint8_t xoffset, uint8_t yoffset, uint8_t width, uint8_t height);
 uint8_t _snowy_display_wait_FPGA_ready(void);
 void _snowy_display_splash(uint8_t scene);
 void _snowy_display_full_init(void);
-void _snowy_display_program_FPGA(void);
-void _snowy_display_send_frame(void);
+static void _snowy_display_program_FPGA_start(void);
+static void _snowy_display_program_FPGA_finish(void);
+void _snowy_display_send_frame(uint8_t first, uint8_t count);
 void _snowy_display_init_SPI6(void);
 void _snowy_display_cs(uint8_t enabled);
 uint8_t _snowy_display_SPI6_getver(uint8_t data);
@@ -43,7 +85,12 @@ void _snowy_display_drawscene(uint8_t scene);
 void _snowy_display_init_intn(void);
 void _snowy_display_dma_send(uint8_t *data, uint32_t len);
 void _snowy_display_next_column(uint8_t col_index);
+static void _snowy_display_stage_column(uint8_t col_index);
 void _snowy_display_init_dma(void);
+static void _snowy_display_next_chunk(void);
+#if defined(SNOWY_DISPLAY_FRAME_DMA) && !defined(DISPLAY_NATIVE_FRAMEBUFFER)
+static uint16_t _snowy_display_convert_changed(uint8_t first, uint8_t count, uint8_t force);
+#endif
 
 // pointer to the place in flash where the FPGA image resides
 // extern unsigned char fpga_address; // _binary_Resources_FPGA_4_3_snowy_dumped_bin_start;
@@ -85,6 +132,9 @@ display_t display = {
     .pin_intn        = GPIO_Pin_10,
 };
 
+/* The framebuffer we convert from. Our own unless told otherwise */
+static uint8_t *_frame_source = display.frame_buffer;
+
 /*
  * Initialise the hardware. This means all GPIOs and SPI for the display
  */
@@ -335,11 +385,24 @@ void snowy_display_reinit_dma(uint32_t *data, uint32_t length)
  */
 void DMA2_Stream5_IRQHandler()
 {
+#ifndef SNOWY_DISPLAY_FRAME_DMA
     static uint8_t col_index = 0;
+#endif
     
     if (DMA_GetITStatus(DMA2_Stream5, DMA_IT_TCIF5))
     {
         DMA_ClearITPendingBit(DMA2_Stream5, DMA_IT_TCIF5);
+        _frame_isrs++;
+
+#ifdef SNOWY_DISPLAY_FRAME_DMA
+        // more of the frame left? chain it straight on. The SPI keeps
+        // shifting the last byte while the stream restarts
+        if (_native_sent < MAX_FRAMEBUFFER_SIZE)
+        {
+            _snowy_display_next_chunk();
+            return;
+        }
+#endif
 
         // check the tx finished
         while (SPI_I2S_GetFlagStatus(SPI6, SPI_I2S_FLAG_TXE) == RESET)
@@ -351,21 +414,27 @@ void DMA2_Stream5_IRQHandler()
         {
         };
 
+#ifndef SNOWY_DISPLAY_FRAME_DMA
         // if we are finished sending  each column, then reset and stop
         if (col_index < ROW_LENGTH - 1)
         {
             ++col_index;
-            // ask for convert and display the next column
+            // send the staged column and convert the one after it
             _snowy_display_next_column(col_index);
             return;
         }
                 
         // done. We are still in control of the SPI select, so lets let go
         col_index = 0;
+#endif
         
         _snowy_display_cs(0);
         _display_ready = 1;
         
+        display_stat_record(DisplayStatTransfer, display_stat_elapsed_us(_frame_dma_start));
+        display_stat_record(DisplayStatConvert, _frame_convert_us);
+        display_stat_record(DisplayStatIsrs, _frame_isrs);
+        
         /* request_clocks in _snowy_display_start_frame */
         _snowy_display_release_clocks();
         
@@ -431,23 +500,130 @@ uint8_t _snowy_display_SPI6_send(uint8_t data)
 }
 
 /*
- * Given a column index, start the conversion of the display data and dma it
+ * Convert a column into its staging buffer. Even columns go into the
+ * first buffer, odd ones into the second
+ */
+static void _snowy_display_stage_column(uint8_t col_index)
+{
+    uint32_t start = display_stat_timestamp();
+    
+    scanline_convert(_column_buffer[col_index & 1], _frame_source, col_index);
+    _frame_convert_us += display_stat_elapsed_us(start);
+}
+
+/*
+ * Given a column index, dma the already staged column out and
+ * convert the one after it while the transfer is running
  */
 void _snowy_display_next_column(uint8_t col_index)
 {   
-    // set the content
-    scanline_convert(_column_buffer, display.frame_buffer, col_index);
-    _snowy_display_dma_send(_column_buffer, COLUMN_LENGTH);
+    _snowy_display_dma_send(_column_buffer[col_index & 1], COLUMN_LENGTH);
+    
+    // the other buffer was sent last time round, so it is free to reuse
+    if (col_index < ROW_LENGTH - 1)
+        _snowy_display_stage_column(col_index + 1);
+}
+
+#ifdef SNOWY_DISPLAY_FRAME_DMA
+/*
+ * Send the next piece of the native frame, as big as the DMA allows
+ */
+static void _snowy_display_next_chunk(void)
+{
+    uint32_t len = MAX_FRAMEBUFFER_SIZE - _native_sent;
+    
+    if (len > SNOWY_DISPLAY_DMA_CHUNK)
+        len = SNOWY_DISPLAY_DMA_CHUNK;
+    
+    _snowy_display_dma_send(_native_frame + _native_sent, len);
+    _native_sent += len;
+}
+#endif
+
+#if defined(SNOWY_DISPLAY_FRAME_DMA) && !defined(DISPLAY_NATIVE_FRAMEBUFFER)
+/*
+ * Hash a group of lines of the framebuffer. A word at a time, so
+ * on snowy this walks four columns down the rows together
+ */
+static uint32_t _snowy_display_hash_group(uint8_t group)
+{
+#if defined(REBBLE_PLATFORM_CHALK)
+    uint32_t *src = (uint32_t *)(_frame_source + group * DISPLAY_COLS);
+    const uint16_t words = DISPLAY_COLS / 4, stride = 1;
+#else
+    uint32_t *src = (uint32_t *)(_frame_source + group * 4);
+    const uint16_t words = DISPLAY_ROWS, stride = DISPLAY_COLS / 4;
+#endif
+    uint32_t hash = group;
+    
+    // multiply and xorshift each word in, so a change in one word
+    // can't be cancelled out by a matching change a few words on
+    for (uint16_t i = 0; i < words; i++, src += stride)
+    {
+        hash = (hash ^ *src) * 0x9E3779B1;
+        hash ^= hash >> 15;
+    }
+    
+    return hash;
+}
+
+/*
+ * Convert the lines in the given range that changed since they were
+ * last converted. Runs of changed groups are converted in one go.
+ * force converts them all regardless. Returns the lines left alone
+ */
+static uint16_t _snowy_display_convert_changed(uint8_t first, uint8_t count, uint8_t force)
+{
+    uint8_t group_first = first / HASH_LINES;
+    uint8_t group_end = (first + count + HASH_LINES - 1) / HASH_LINES;
+    int16_t run = -1;
+    uint16_t skipped = 0;
+    uint32_t hash;
+    uint8_t changed;
+    
+    for (uint8_t g = group_first; g <= group_end; g++)
+    {
+        changed = 0;
+        if (g < group_end)
+        {
+            hash = _snowy_display_hash_group(g);
+            changed = force || hash != _line_hash[g];
+            _line_hash[g] = hash;
+            if (!changed)
+                skipped += HASH_LINES;
+        }
+        
+        if (changed && run < 0)
+        {
+            run = g;
+        }
+        else if (!changed && run >= 0)
+        {
+            scanline_convert_range(_native_buffer, _frame_source,
+                                   run * HASH_LINES, (g - run) * HASH_LINES);
+            run = -1;
+        }
+    }
+    
+    return skipped > count ? count : skipped;
 }
+#endif
 
 /*
  * Send n bytes over SPI using the DMA engine.
  * This will async run and call the ISR when complete
+ *
+ * The stream is left configured by _snowy_display_init_dma, so
+ * only the address and count need changing between transfers
  */
 void _snowy_display_dma_send(uint8_t *data, uint32_t length)
 {
-    // re-initialise the DMA controller. prep for send
-    snowy_display_reinit_dma((uint32_t *)data, length);
+    DMA_Cmd(DMA2_Stream5, DISABLE);
+    while (DMA2_Stream5->CR & DMA_SxCR_EN);
+
+    DMA_ClearFlag(DMA2_Stream5, DMA_FLAG_FEIF5|DMA_FLAG_DMEIF5|DMA_FLAG_TEIF5|DMA_FLAG_HTIF5|DMA_FLAG_TCIF5);
+    DMA_MemoryTargetConfig(DMA2_Stream5, (uint32_t)data, DMA_Memory_0);
+    DMA_SetCurrDataCounter(DMA2_Stream5, length);
     DMA_Cmd(DMA2_Stream5, ENABLE);
     
     return;
@@ -545,8 +721,11 @@ void _snowy_display_SPI_end(void)
 /*
  * Start to send a frame to the display driver
  * If it says yes, then we can then tell someone to fill the buffer
+ *
+ * The FPGA only knows how to take a whole frame, so the region only
+ * limits which lines get converted again. Columns on snowy, rows on chalk
  */
-void _snowy_display_start_frame(uint8_t xoffset, uint8_t yoffset)
+void _snowy_display_start_frame(uint8_t xoffset, uint8_t yoffset, uint8_t width, uint8_t height)
 {
     _snowy_display_request_clocks();
 
@@ -558,23 +737,80 @@ void _snowy_display_start_frame(uint8_t xoffset, uint8_t yoffset)
 
     _display_ready = 0;
 
-    _snowy_display_send_frame();
+#if defined(REBBLE_PLATFORM_CHALK)
+    _snowy_display_send_frame(yoffset, height);
+#else
+    _snowy_display_send_frame(xoffset, width);
+#endif
     /* release_clocks in DMA2_Stream5_IRQHandler */
 }
 
 /* 
  * We can fill the framebuffer now. Depending on mode, we will DMA
  * the data directly over to the display
+ *
+ * first and count are the lines that changed since the last frame.
+ * The rest of the native buffer is still good from last time
  */
-void _snowy_display_send_frame()
+void _snowy_display_send_frame(uint8_t first, uint8_t count)
 {
 //     return _snowy_display_send_frame_slow();
+#if defined(DISPLAY_NATIVE_FRAMEBUFFER)
+    // drawn in the FPGA's layout already, so there is nothing to convert
+    _frame_isrs = 0;
+    _frame_convert_us = 0;
+    _native_frame = _frame_source;
+    _native_sent = 0;
+    
+    _snowy_display_cs(1);
+    delay_us(80);
+    _frame_dma_start = display_stat_timestamp();
+    _snowy_display_next_chunk();
+#elif defined(SNOWY_DISPLAY_FRAME_DMA)
+    uint8_t force = !_native_valid || ++_frames_since_full >= SNOWY_DISPLAY_FULL_CONVERT_FRAMES;
+    
+    if (force)
+    {
+        first = 0;
+        count = ROW_LENGTH;
+        _native_valid = 1;
+        _frames_since_full = 0;
+    }
+    
+    if (first + count > ROW_LENGTH)
+        count = ROW_LENGTH - first;
+    
+    _frame_isrs = 0;
+    
+    // convert before taking the bus, then stream the whole frame.
+    // The FPGA only takes whole frames, so skipped lines still get sent
+    uint32_t start = display_stat_timestamp();
+    uint16_t skipped = _snowy_display_convert_changed(first, count, force);
+    _frame_convert_us = display_stat_elapsed_us(start);
+    if (count)
+        display_stat_record(DisplayStatSkipped, skipped * 100 / count);
+    _native_frame = _native_buffer;
+    _native_sent = 0;
+    
+    _snowy_display_cs(1);
+    delay_us(80);
+    _frame_dma_start = display_stat_timestamp();
+    _snowy_display_next_chunk();
+#else
     _snowy_display_cs(1);
     delay_us(80);
     // send over DMA
     // we are only going to send one single column at a time
-    // the dma engine completion will trigger the next lot of data to go
-    _snowy_display_next_column(0);
+    // the dma engine completion will trigger the next lot of data to go.
+    // Stage both buffers before starting so the ISR never finds
+    // an unconverted column if we get preempted here
+    _frame_isrs = 0;
+    _frame_convert_us = 0;
+    _snowy_display_stage_column(0);
+    _snowy_display_stage_column(1);
+    _frame_dma_start = display_stat_timestamp();
+    _snowy_display_dma_send(_column_buffer[0], COLUMN_LENGTH);
+#endif
     // we return immediately and let the system take care of the rest
 }
 
@@ -594,12 +830,17 @@ void _snowy_display_send_frame_slow()
     _snowy_display_cs(1);
     
     // send via standard SPI
+#ifdef DISPLAY_NATIVE_FRAMEBUFFER
+    for (uint32_t i = 0; i < MAX_FRAMEBUFFER_SIZE; i++)
+        _snowy_display_SPI6_send(_frame_source[i]);
+#else
     for(uint8_t x = 0; x < DISPLAY_COLS; x++)
     {
-        scanline_convert(_column_buffer, display.frame_buffer, x);
+        scanline_convert(_column_buffer[0], _frame_source, x);
         for (uint8_t j = 0; j < DISPLAY_ROWS; j++)
-            _snowy_display_SPI6_send(_column_buffer[j]);
+            _snowy_display_SPI6_send(_column_buffer[0][j]);
     }   
+#endif
     
     _snowy_display_cs(0);
    _snowy_display_release_clocks();
@@ -649,22 +890,42 @@ void _snowy_display_full_init(void)
     _snowy_display_request_clocks();    
     hw_display_on();
     
+#if defined(SNOWY_DISPLAY_FRAME_DMA) && !defined(DISPLAY_NATIVE_FRAMEBUFFER)
+    // the splash overwrites the framebuffer behind our back
+    _native_valid = 0;
+#endif
+    
     if (!_snowy_display_FPGA_reset(0)) // full fat
     {
         _snowy_display_release_clocks();
         assert(!"FGPA Init FAILED!!");
     }
     
-    _snowy_display_program_FPGA();
+    _snowy_display_program_FPGA_start();
+    
+    // get the splashscreen resource handle and read it directly into the framebuffer
+    // The external flash is on the FSMC, so this runs alongside the upload
+    ResHandle resource_handle = resource_get_handle_system(SPLASH_RESOURCE_ID);
+#ifdef DISPLAY_NATIVE_FRAMEBUFFER
+    // the splash is stored a row at a time. Bring it in two rows at a
+    // time through the column buffers, which are big enough for a pair
+    for (uint8_t y = 0; y < DISPLAY_ROWS; y += 2)
+    {
+        hw_flash_read_bytes(REGION_RES_START + RES_START + resource_handle.offset + y * DISPLAY_COLS,
+                            _column_buffer[0], 2 * DISPLAY_COLS);
+        scanline_convert_rows_native(_frame_source, _column_buffer[0], y);
+    }
+#else
+    hw_flash_read_bytes(REGION_RES_START + RES_START + resource_handle.offset, _frame_source, resource_handle.size);
+#endif
+    
+    _snowy_display_program_FPGA_finish();
     
     if (_snowy_display_wait_FPGA_ready())
     {
         DRV_LOG("Display", APP_LOG_LEVEL_INFO, "Display is ready");
     }
     
-    // get the splashscreen resource handle and read it directly into the framebuffer
-    ResHandle resource_handle = resource_get_handle_system(SPLASH_RESOURCE_ID);
-    hw_flash_read_bytes(REGION_RES_START + RES_START + resource_handle.offset, display.frame_buffer, resource_handle.size);
     // send raw splashscreen image to display
     _snowy_display_send_frame_slow();
 
@@ -674,23 +935,89 @@ void _snowy_display_full_init(void)
 }
 
 /*
- * Get the source for the display's FPGA, and download it to the device
+ * Send the next piece of the FPGA image, as big as the DMA allows
  */
-void _snowy_display_program_FPGA(void)
+static void _snowy_display_FPGA_next_chunk(void)
 {
-    unsigned char *fpga_blob = DISPLAY_FPGA_ADDR;
-           
+    uint32_t len = _fpga_remaining;
+    
+    if (len > SNOWY_DISPLAY_DMA_CHUNK)
+        len = SNOWY_DISPLAY_DMA_CHUNK;
+    
+    _snowy_display_dma_send((uint8_t *)_fpga_blob, len);
+    _fpga_blob += len;
+    _fpga_remaining -= len;
+}
+
+/*
+ * Get the source for the display's FPGA, and start downloading it to the device.
+ * Completion is polled in _snowy_display_program_FPGA_finish rather than
+ * taken on the interrupt, as the TC handler belongs to frame sends.
+ * At boot that is free, the splash is read from flash in the meantime.
+ * From hw_display_reset it busy-waits in the calling task for whatever
+ * of the upload the splash read didn't cover
+ */
+static void _snowy_display_program_FPGA_start(void)
+{
+    // time the upload with the cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    _fpga_upload_start = DWT->CYCCNT;
+    
+    _fpga_blob = DISPLAY_FPGA_ADDR;
+    _fpga_remaining = (uint32_t)DISPLAY_FPGA_SIZE;
+    
+    // keep the frame completion handler out of it
+    DMA_ITConfig(DMA2_Stream5, DMA_IT_TC, DISABLE);
+    
     _snowy_display_cs(1);
+    _snowy_display_FPGA_next_chunk();
+}
+
+/*
+ * Wait for the rest of the FPGA image to go out
+ */
+static void _snowy_display_program_FPGA_finish(void)
+{
+    uint32_t wait_start = DWT->CYCCNT;
+    uint32_t mhz = SystemCoreClock / 1000000;
     
-    // Do this with good ol manual SPI for reliability
-    for (uint32_t i = 0; i < (uint32_t)DISPLAY_FPGA_SIZE; i++)
+    while (1)
     {
-        _snowy_display_SPI6_send(*(fpga_blob + i));
+        if (DMA_GetFlagStatus(DMA2_Stream5, DMA_FLAG_TEIF5) == SET)
+        {
+            // the reset/ready checks will catch a half programmed FPGA
+            DRV_LOG("Display", APP_LOG_LEVEL_ERROR, "FPGA bin DMA error");
+            break;
+        }
+        
+        if (DMA_GetFlagStatus(DMA2_Stream5, DMA_FLAG_TCIF5) == RESET)
+            continue;
+        
+        if (!_fpga_remaining)
+            break;
+        
+        _snowy_display_FPGA_next_chunk();
     }
     
+    // let the last byte leave the shift register
+    while (SPI_I2S_GetFlagStatus(SPI6, SPI_I2S_FLAG_TXE) == RESET);
+    while (SPI_I2S_GetFlagStatus(SPI6, SPI_I2S_FLAG_BSY) == SET);
+    
     _snowy_display_cs(0);
     
-    DRV_LOG("Display", APP_LOG_LEVEL_DEBUG, "FPGA bin uploaded");
+    // we never read anything back, so clear the overrun
+    // before the byte wise routines use the SPI again
+    (void)SPI6->DR;
+    (void)SPI6->SR;
+    
+    DMA_ClearFlag(DMA2_Stream5, DMA_FLAG_FEIF5|DMA_FLAG_DMEIF5|DMA_FLAG_TEIF5|DMA_FLAG_HTIF5|DMA_FLAG_TCIF5);
+    DMA_ITConfig(DMA2_Stream5, DMA_IT_TC, ENABLE);
+    
+    DRV_LOG("Display", APP_LOG_LEVEL_DEBUG, "FPGA bin uploaded, %d bytes in %d us, %d us spent waiting",
+            (uint32_t)DISPLAY_FPGA_SIZE,
+            (DWT->CYCCNT - _fpga_upload_start) / mhz,
+            (DWT->CYCCNT - wait_start) / mhz);
 }
 
 
@@ -714,9 +1041,9 @@ void hw_display_on()
 /*
  * Start a frame render
  */
-void hw_display_start_frame(uint8_t xoffset, uint8_t yoffset)
+void hw_display_start_frame(uint8_t xoffset, uint8_t yoffset, uint8_t width, uint8_t height)
 {
-    _snowy_display_start_frame(xoffset, yoffset);
+    _snowy_display_start_frame(xoffset, yoffset, width, height);
 }
 
 uint8_t *hw_display_get_buffer(void)
@@ -724,6 +1051,15 @@ uint8_t *hw_display_get_buffer(void)
     return display.frame_buffer;
 }
 
+/*
+ * Send frames from a different buffer. Only change this
+ * while no frame is in flight
+ */
+void hw_display_set_buffer(uint8_t *buffer)
+{
+    _frame_source = buffer;
+}
+
 uint8_t hw_display_is_ready()
 {
     return _display_ready;
@@ -732,7 +1068,8 @@ uint8_t hw_display_is_ready()
 /*
  * Reset the display
  * Needs work before it works (ahem) after first boot
- * as interrupts are still enabled and get all in the way
+ * as interrupts are still enabled and get all in the way.
+ * Reprograms the FPGA, so the caller spins until the upload is done
  */
 void hw_display_reset(void)
 {
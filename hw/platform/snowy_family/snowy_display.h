@@ -11,6 +11,31 @@
 
 #define MAX_FRAMEBUFFER_SIZE DISPLAY_ROWS * DISPLAY_COLS
 
+// The FPGA takes a frame as a run of lines. Columns on snowy, rows on chalk
+#if defined(REBBLE_PLATFORM_CHALK)
+#define DISPLAY_LINE_LENGTH DISPLAY_COLS
+#else
+#define DISPLAY_LINE_LENGTH DISPLAY_ROWS
+#endif
+
+// Convert the whole frame up front and stream it out with as few DMA
+// transfers as possible, rather than converting and sending a column
+// from every DMA interrupt. Comment out to go back to per column mode
+#define SNOWY_DISPLAY_FRAME_DMA
+// Largest single DMA transfer. The stream's data counter is 16 bits
+#define SNOWY_DISPLAY_DMA_CHUNK 0xFFFF
+
+#if defined(DISPLAY_NATIVE_FRAMEBUFFER) && !defined(SNOWY_DISPLAY_FRAME_DMA)
+#error "DISPLAY_NATIVE_FRAMEBUFFER needs SNOWY_DISPLAY_FRAME_DMA"
+#endif
+
+// We can send from any buffer given to hw_display_set_buffer, so the
+// display core can draw into one while we send the other. That costs a
+// whole extra framebuffer, and with SNOWY_DISPLAY_FRAME_DMA the front one
+// is only read while it is converted, not while it goes out, so all it
+// buys is drawing during the conversion. Define DISPLAY_DOUBLE_BUFFER in
+// the platform's platform_config.h to have it anyway
+
 // display command types
 #define DISPLAY_CTYPE_NULL        0x00
 #define DISPLAY_CTYPE_PARAM       0x01
@@ -37,7 +62,8 @@ typedef struct {
     
     //state
     uint8_t power_on;   
-    uint8_t frame_buffer[DISPLAY_ROWS * DISPLAY_COLS];
+    // word aligned for the scanline converters
+    uint8_t frame_buffer[DISPLAY_ROWS * DISPLAY_COLS] __attribute__((aligned(4)));
 } display_t;
 
 
@@ -50,12 +76,16 @@ void hw_backlight_init(void);
 void hw_backlight_set(uint16_t val);
 uint8_t hw_display_is_ready();
 uint8_t *hw_display_get_buffer(void);
+void hw_display_set_buffer(uint8_t *buffer);
 
 void hw_display_on();
-void hw_display_start_frame(uint8_t xoffset, uint8_t yoffset);
+void hw_display_start_frame(uint8_t xoffset, uint8_t yoffset, uint8_t width, uint8_t height);
 
 // TODO: move to scanline
 void scanline_convert(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t column_index);
+void scanline_convert_range(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t first, uint8_t count);
+void scanline_convert_rows_native(uint8_t *native_buffer, uint8_t *rows, uint8_t row_index);
+void scanline_native_get_row(uint8_t *row, uint8_t *native_buffer, uint8_t row_index);
 // void scanline_rgb888pixel_to_frambuffer(UG_S16 x, UG_S16 y, UG_COLOR c);
 
 void delay_us(uint16_t us);
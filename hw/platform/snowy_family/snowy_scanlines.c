@@ -21,11 +21,25 @@ extern display_t display;
  * (y0: xxxxxxx
  *  y1: xxxxxxx)
  * In LSB / MSB format
+ *
+ * Works a word at a time. Each word holds two pixel pairs, and as we are
+ * little endian the first pixel of each pair is the low byte of a halfword,
+ * so both pairs are formatted with one set of masks
  */
 void _scanline_convert_row(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t row_index)
 {
-    uint8_t r0_fullbyte, r1_fullbyte, lsb, msb;
-    uint32_t row_offset = row_index * DISPLAY_COLS;
+    uint32_t *row = (uint32_t *)(frame_buffer + row_index * DISPLAY_COLS);
+    uint16_t *lsb_out = (uint16_t *)out_buffer;
+    uint16_t *msb_out = (uint16_t *)(out_buffer + DISPLAY_COLS / 2);
+    uint32_t w, lsb, msb;
+    uint16_t first = 0, last = DISPLAY_COLS / 4;
+
+#ifdef PBL_ROUND
+    // pixels outside the circle are never shown, so only convert the
+    // words that overlap the visible span of this row
+    first = display_row_inset[row_index] / 4;
+    last = (DISPLAY_COLS - display_row_inset[row_index] + 3) / 4;
+#endif
 
     // For each column in the row, grab two consecutive bytes
     // Each pair of bytes is then or'd to form a pair of formatted values
@@ -33,16 +47,16 @@ void _scanline_convert_row(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t r
     // They are then pushed into the row buffer. 
     // LSB block filling the first half, MSB the second half
     // [LSB0 LSB1..... | half | MSB0 MSB1.....]
-    for (uint16_t xi = 0; xi < DISPLAY_COLS; xi+=2)
+    for (uint16_t i = first; i < last; i++)
     {
-        r1_fullbyte = frame_buffer[row_offset + xi];
-        r0_fullbyte = frame_buffer[row_offset + xi + 1];
+        w = row[i];
         
-        lsb = (r0_fullbyte & (0b00101010)) >> 1 | (r1_fullbyte & (0b00101010));
-        msb = (r0_fullbyte & (0b00010101)) | (r1_fullbyte & (0b00010101)) << 1;
-            
-        out_buffer[xi/2] = lsb;
-        out_buffer[(xi/2) + DISPLAY_COLS / 2] = msb;
+        lsb = (w & 0x002A002A) | ((w >> 9) & 0x00150015);
+        msb = ((w >> 8) & 0x00150015) | ((w << 1) & 0x002A002A);
+        
+        // results are in bytes 0 and 2, pull them together
+        lsb_out[i] = lsb | (lsb >> 8);
+        msb_out[i] = msb | (msb >> 8);
     }
 }
 
@@ -84,6 +98,45 @@ void _scanline_convert_column(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_
     }
 }
 
+#if defined(REBBLE_PLATFORM_SNOWY)
+/*
+ * Convert four neighbouring columns at once. A word read of each row
+ * covers all four, and every byte lane is formatted in parallel.
+ * The results are scattered into four consecutive column buffers
+ * starting at out_buffer. column_index must be a multiple of 4
+ */
+static void _scanline_convert_column4(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t column_index)
+{
+    uint32_t *src = (uint32_t *)(frame_buffer + column_index);
+    uint16_t halfrows = DISPLAY_ROWS / 2;
+    uint16_t halfy;
+    uint32_t w0, w1, lsb, msb;
+    
+    for (uint16_t yi = 0; yi < DISPLAY_ROWS; yi+=2)
+    {
+        halfy = (DISPLAY_ROWS - 1 - yi) / 2;
+        
+        w0 = src[0];
+        w1 = src[DISPLAY_COLS / 4];
+        
+        lsb = ((w0 >> 1) & 0x15151515) | (w1 & 0x2A2A2A2A);
+        msb = (w0 & 0x15151515) | ((w1 << 1) & 0x2A2A2A2A);
+        
+        out_buffer[halfy]                                = lsb;
+        out_buffer[halfrows + halfy]                     = msb;
+        out_buffer[DISPLAY_ROWS + halfy]                 = lsb >> 8;
+        out_buffer[DISPLAY_ROWS + halfrows + halfy]      = msb >> 8;
+        out_buffer[2 * DISPLAY_ROWS + halfy]             = lsb >> 16;
+        out_buffer[2 * DISPLAY_ROWS + halfrows + halfy]  = msb >> 16;
+        out_buffer[3 * DISPLAY_ROWS + halfy]             = lsb >> 24;
+        out_buffer[3 * DISPLAY_ROWS + halfrows + halfy]  = msb >> 24;
+        
+        // skip the next y row as we processed it already
+        src += DISPLAY_COLS / 2;
+    }
+}
+#endif
+
 void scanline_convert(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t index)
 {
 #if defined(REBBLE_PLATFORM_CHALK)
@@ -94,3 +147,72 @@ void scanline_convert(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t index)
     assert(!"I don't know how to drive this platform!");
 #endif
 }
+
+/*
+ * Convert a run of lines into a buffer laid out the way the FPGA
+ * takes the whole frame. Line n lands at n * DISPLAY_LINE_LENGTH
+ */
+void scanline_convert_range(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t first, uint8_t count)
+{
+    uint16_t i = first;
+    uint16_t end = first + count;
+    
+#if defined(REBBLE_PLATFORM_SNOWY)
+    // single columns up to a word boundary, then four at a time
+    for (; i < end && (i & 3); i++)
+        _scanline_convert_column(out_buffer + i * DISPLAY_LINE_LENGTH, frame_buffer, i);
+    
+    for (; i + 4 <= end; i += 4)
+        _scanline_convert_column4(out_buffer + i * DISPLAY_LINE_LENGTH, frame_buffer, i);
+#endif
+    
+    for (; i < end; i++)
+        scanline_convert(out_buffer + i * DISPLAY_LINE_LENGTH, frame_buffer, i);
+}
+
+#if defined(DISPLAY_NATIVE_FRAMEBUFFER)
+/*
+ * Scatter two consecutive framebuffer rows, starting at an even row,
+ * into a frame held in the FPGA's own column layout. Used to bring in
+ * images stored a row at a time, such as the splash
+ */
+void scanline_convert_rows_native(uint8_t *native_buffer, uint8_t *rows, uint8_t row_index)
+{
+    uint8_t *out = native_buffer + (DISPLAY_ROWS - 1 - row_index) / 2;
+    uint8_t r0_fullbyte, r1_fullbyte;
+    
+    for (uint16_t x = 0; x < DISPLAY_COLS; x++)
+    {
+        r0_fullbyte = rows[x];
+        r1_fullbyte = rows[x + DISPLAY_COLS];
+        
+        out[0] = (r0_fullbyte & (0b00101010)) >> 1 | (r1_fullbyte & (0b00101010));
+        out[DISPLAY_ROWS / 2] = (r0_fullbyte & (0b00010101)) | (r1_fullbyte & (0b00010101)) << 1;
+        
+        out += DISPLAY_ROWS;
+    }
+}
+
+/*
+ * The other way, gather one framebuffer row back out of a frame in the
+ * FPGA's column layout. The layout has no alpha, so pixels come back opaque
+ */
+void scanline_native_get_row(uint8_t *row, uint8_t *native_buffer, uint8_t row_index)
+{
+    uint8_t *in = native_buffer + (DISPLAY_ROWS - 1 - row_index) / 2;
+    uint8_t lsb, msb;
+    
+    for (uint16_t x = 0; x < DISPLAY_COLS; x++)
+    {
+        lsb = in[0];
+        msb = in[DISPLAY_ROWS / 2];
+        
+        if (row_index & 1)
+            row[x] = 0b11000000 | (lsb & 0b00101010) | (msb & 0b00101010) >> 1;
+        else
+            row[x] = 0b11000000 | (lsb & 0b00010101) << 1 | (msb & 0b00010101);
+        
+        in += DISPLAY_ROWS;
+    }
+}
+#endif
@@ -14,11 +14,15 @@
 #include <stm32f2xx_spi.h>
 #include <stm32f2xx_rcc.h>
 #include <stm32f2xx_syscfg.h>
+#include <stm32f2xx_dma.h>
 #include <misc.h>
 
 #include "stm32_power.h"
+#include "display.h"
 
 extern void *strcpy(char *a2, const char *a1);
+extern void *memcpy(void *dest, const void *src, size_t n);
+extern int memcmp(const void *s1, const void *s2, size_t n);
 
 /*** debug routines ***/
 
@@ -143,8 +147,20 @@ STM32_BUTTONS_MK_IRQ_HANDLER(1)
 
 /* display */
 
-static uint8_t _display_fb[168][20];
+/* The Sharp memory LCD takes a mode byte, then any number of line
+ * records [address, 18 bytes of pixels, 0], then a trailing 0. It wants
+ * everything LSB first, so the records are kept pre-reversed and only
+ * the lines that differ from what is on the glass get sent. */
+#define DISPLAY_LINE_BYTES   18
+#define DISPLAY_RECORD_BYTES (DISPLAY_LINE_BYTES + 2)
 
+static uint8_t _display_fb[168][20] __attribute__((aligned(4)));
+static uint8_t _display_records[168][DISPLAY_RECORD_BYTES];
+static uint8_t _display_tx[1 + 168 * DISPLAY_RECORD_BYTES + 1];
+/* set until the panel has been written in full once */
+static uint8_t _display_send_all;
+
+static void _display_init_dma(void);
 
 void hw_display_init() {
     printf("tintin: hw_display_init\n");
@@ -200,42 +216,150 @@ void hw_display_init() {
     stm32_power_release(STM32_POWER_APB1, RCC_APB1Periph_SPI2);
     stm32_power_release(STM32_POWER_AHB1, RCC_AHB1Periph_GPIOB);
     stm32_power_release(STM32_POWER_AHB1, RCC_AHB1Periph_GPIOC);
+
+    /* Line addresses never change, so reverse them once. The panel is
+     * upside down relative to the framebuffer. */
+    for (int i = 0; i < 168; i++) {
+        _display_records[i][0] = __RBIT(__REV(167 - i));
+        _display_records[i][DISPLAY_RECORD_BYTES - 1] = 0;
+    }
+    _display_send_all = 1;
+    
+    _display_init_dma();
+}
+
+/* SPI2 TX is DMA1 stream 4, channel 0 */
+static void _display_init_dma(void) {
+    DMA_InitTypeDef dmainit;
+    NVIC_InitTypeDef nvicinit;
+
+    stm32_power_request(STM32_POWER_AHB1, RCC_AHB1Periph_DMA1);
+    stm32_power_request(STM32_POWER_APB1, RCC_APB1Periph_SPI2);
+
+    DMA_DeInit(DMA1_Stream4);
+    DMA_StructInit(&dmainit);
+    dmainit.DMA_Channel = DMA_Channel_0;
+    dmainit.DMA_PeripheralBaseAddr = (uint32_t)&SPI2->DR;
+    dmainit.DMA_Memory0BaseAddr = (uint32_t)_display_tx;
+    dmainit.DMA_DIR = DMA_DIR_MemoryToPeripheral;
+    dmainit.DMA_BufferSize = 1;
+    dmainit.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    dmainit.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    dmainit.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    dmainit.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    dmainit.DMA_Mode = DMA_Mode_Normal;
+    dmainit.DMA_Priority = DMA_Priority_High;
+    dmainit.DMA_FIFOMode = DMA_FIFOMode_Disable;
+    DMA_Init(DMA1_Stream4, &dmainit);
+    DMA_ITConfig(DMA1_Stream4, DMA_IT_TC, ENABLE);
+    SPI_I2S_DMACmd(SPI2, SPI_I2S_DMAReq_Tx, ENABLE);
+
+    stm32_power_release(STM32_POWER_APB1, RCC_APB1Periph_SPI2);
+    stm32_power_release(STM32_POWER_AHB1, RCC_AHB1Periph_DMA1);
+
+    nvicinit.NVIC_IRQChannel = DMA1_Stream4_IRQn;
+    nvicinit.NVIC_IRQChannelPreemptionPriority = 9;
+    nvicinit.NVIC_IRQChannelSubPriority = 0;
+    nvicinit.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&nvicinit);
 }
 
 void hw_display_reset() {
     printf("tintin: hw_display_reset\n");
+    _display_send_all = 1;
 }
 
 void hw_display_start() {
     printf("tintin: hw_display_start\n");
 }
 
-static void _display_write(unsigned char c) {
-    SPI2->DR = c;
-    while (!(SPI2->SR & SPI_SR_TXE))
-        ;
+/* When the current frame's DMA was kicked off */
+static uint32_t _display_dma_start;
+
+/* Reverse the bits of each byte of a framebuffer line into a record.
+ * Rows are word aligned, so go a word at a time. */
+static void _display_reverse_line(uint8_t *out, const uint8_t *row) {
+    const uint32_t *words = (const uint32_t *)row;
+    uint32_t rev[5];
+
+    for (int i = 0; i < 5; i++)
+        rev[i] = __RBIT(__REV(words[i]));
+    memcpy(out, rev, DISPLAY_LINE_BYTES);
 }
 
-void hw_display_start_frame(uint8_t x, uint8_t y) {
+/* The panel is addressed by line, so only the rows in the region that
+ * actually changed are sent. Columns always go out whole. Completion is
+ * reported from the DMA interrupt. */
+void hw_display_start_frame(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+    uint8_t line[DISPLAY_LINE_BYTES];
+    uint32_t len = 0;
+    uint32_t start = display_stat_timestamp();
+    int all = _display_send_all;
+
+    if (all) {
+        y = 0;
+        height = 168;
+        _display_send_all = 0;
+    }
+
+    _display_tx[len++] = 0x80;
+    for (int i = y; i < y + height && i < 168; i++) {
+        _display_reverse_line(line, _display_fb[i]);
+        if (!all && !memcmp(&_display_records[i][1], line, DISPLAY_LINE_BYTES))
+            continue;
+        memcpy(&_display_records[i][1], line, DISPLAY_LINE_BYTES);
+        memcpy(&_display_tx[len], _display_records[i], DISPLAY_RECORD_BYTES);
+        len += DISPLAY_RECORD_BYTES;
+    }
+    _display_tx[len++] = 0;
+    display_stat_record(DisplayStatConvert, display_stat_elapsed_us(start));
+
+    if (len == 2) {
+        /* nothing changed, we're done already */
+        display_done_ISR(0);
+        return;
+    }
+
     stm32_power_request(STM32_POWER_AHB1, RCC_AHB1Periph_GPIOB);
     stm32_power_request(STM32_POWER_APB1, RCC_APB1Periph_SPI2);
+    stm32_power_request(STM32_POWER_AHB1, RCC_AHB1Periph_DMA1);
 
-    printf("tintin: here we go, slowly blitting %d %d\n", x, y);
     GPIO_WriteBit(GPIOB, 1 << 12, 1);
     delay_us(7);
-    _display_write(0x80);
-    for (int i = 0; i < 168; i++) {
-        _display_write(__RBIT(__REV(167-i)));
-        for (int j = 0; j < 18; j++)
-            _display_write(__RBIT(__REV(_display_fb[i][j])));
-        _display_write(0);
-    }
-    _display_write(0);
-    delay_us(7);
-    GPIO_WriteBit(GPIOB, 1 << 12, 0);
 
-    stm32_power_release(STM32_POWER_APB1, RCC_APB1Periph_SPI2);
-    stm32_power_release(STM32_POWER_AHB1, RCC_AHB1Periph_GPIOB);
+    DMA_Cmd(DMA1_Stream4, DISABLE);
+    while (DMA1_Stream4->CR & DMA_SxCR_EN)
+        ;
+    DMA_ClearFlag(DMA1_Stream4, DMA_FLAG_FEIF4 | DMA_FLAG_DMEIF4 | DMA_FLAG_TEIF4 | DMA_FLAG_HTIF4 | DMA_FLAG_TCIF4);
+    DMA_MemoryTargetConfig(DMA1_Stream4, (uint32_t)_display_tx, DMA_Memory_0);
+    DMA_SetCurrDataCounter(DMA1_Stream4, len);
+    _display_dma_start = display_stat_timestamp();
+    DMA_Cmd(DMA1_Stream4, ENABLE);
+    /* clocks are released in DMA1_Stream4_IRQHandler */
+}
+
+void DMA1_Stream4_IRQHandler() {
+    if (DMA_GetITStatus(DMA1_Stream4, DMA_IT_TCIF4)) {
+        DMA_ClearITPendingBit(DMA1_Stream4, DMA_IT_TCIF4);
+
+        /* let the last byte out before dropping select */
+        while (!(SPI2->SR & SPI_SR_TXE))
+            ;
+        while (SPI2->SR & SPI_SR_BSY)
+            ;
+        delay_us(7);
+        GPIO_WriteBit(GPIOB, 1 << 12, 0);
+
+        /* the whole frame is one transfer */
+        display_stat_record(DisplayStatTransfer, display_stat_elapsed_us(_display_dma_start));
+        display_stat_record(DisplayStatIsrs, 1);
+
+        stm32_power_release(STM32_POWER_AHB1, RCC_AHB1Periph_DMA1);
+        stm32_power_release(STM32_POWER_APB1, RCC_APB1Periph_SPI2);
+        stm32_power_release(STM32_POWER_AHB1, RCC_AHB1Periph_GPIOB);
+
+        display_done_ISR(0);
+    }
 }
 
 uint8_t *hw_display_get_buffer(void) {
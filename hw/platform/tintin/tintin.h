@@ -12,6 +12,8 @@ extern int printf ( const char* , ... );
 
 void debug_init();
 void debug_write(const unsigned char *p, size_t len);
+void log_clock_enable();
+void log_clock_disable();
 void platform_init();
 void platform_init_late();
 
@@ -26,7 +28,7 @@ void delay_us(uint32_t us);
 void hw_display_init();
 void hw_display_reset();
 void hw_display_start();
-void hw_display_start_frame(uint8_t xoffset, uint8_t yoffset);
+void hw_display_start_frame(uint8_t xoffset, uint8_t yoffset, uint8_t width, uint8_t height);
 uint8_t hw_display_get_state();
 uint8_t *hw_display_get_buffer(void);
 
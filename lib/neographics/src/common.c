@@ -20,13 +20,119 @@
 \*/
 
 #include "common.h"
+#include "deferred/deferred.h"
 
 static void n_graphics_prv_setbit(uint8_t * byte, uint8_t pos, bool val) {
     *byte ^= (-val ^ *byte) & (1 << pos);
 }
 
-void n_graphics_set_pixel(n_GContext * ctx, n_GPoint p, n_GColor color) {
 #ifdef PBL_BW
+/*\
+|*| 1-bit rows are a whole number of words (__SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT
+|*| is 20) and the framebuffer is word aligned, so spans are filled a word at
+|*| a time. Pixel x is bit x % 8 of byte x / 8, which on our little endian
+|*| cores is bit x % 32 of word x / 32. The ends are masked, everything
+|*| between is a plain store of the fill pattern.
+\*/
+static void n_graphics_prv_bw_span_masks(uint16_t begin, uint16_t end,
+        uint32_t * first_mask, uint32_t * last_mask) {
+    *first_mask = ~0u << (begin % 32);
+    *last_mask = ~0u >> (31 - end % 32);
+    if (begin / 32 == end / 32)
+        *first_mask &= *last_mask;
+}
+
+static void n_graphics_prv_bw_fill_span(uint8_t * row, uint16_t begin, uint16_t end,
+        uint32_t first_mask, uint32_t last_mask, uint32_t pattern) {
+    uint32_t * word = (uint32_t *) row + begin / 32,
+             * last = (uint32_t *) row + end / 32;
+    *word = (*word & ~first_mask) | (pattern & first_mask);
+    if (word == last)
+        return;
+    while (++word < last)
+        *word = pattern;
+    *word = (*word & ~last_mask) | (pattern & last_mask);
+}
+#endif
+
+#ifdef DISPLAY_NATIVE_FRAMEBUFFER
+/*\
+|*| The framebuffer is in the display's own layout, as the Pebble Time FPGA
+|*| takes it: one column after another, each column running bottom to top
+|*| and split into two bit planes of __SCREEN_HEIGHT / 2 bytes. Rows y and
+|*| y + 1 (y even) share a byte in each plane. The first plane holds color
+|*| bits 1, 3, 5 and the second bits 0, 2, 4. Even rows sit in byte bits
+|*| 0, 2, 4 and odd rows in bits 1, 3, 5. Alpha is dropped.
+\*/
+#define __NATIVE_PLANE (__SCREEN_HEIGHT / 2)
+#define __NATIVE_OFFSET(x, y) ((x) * __SCREEN_HEIGHT + (__SCREEN_HEIGHT - 1 - (y)) / 2)
+
+static void n_graphics_prv_native_bits(uint8_t color, int16_t y,
+        uint8_t * mask, uint8_t * lo, uint8_t * hi) {
+    if (y & 1) {
+        *mask = 0b00101010;
+        *lo = color & 0b00101010;
+        *hi = (color << 1) & 0b00101010;
+    } else {
+        *mask = 0b00010101;
+        *lo = (color >> 1) & 0b00010101;
+        *hi = color & 0b00010101;
+    }
+}
+
+static void n_graphics_prv_native_set(uint8_t * fb, int16_t x, int16_t y, uint8_t color) {
+    uint8_t * p = fb + __NATIVE_OFFSET(x, y);
+    uint8_t mask, lo, hi;
+
+    n_graphics_prv_native_bits(color, y, &mask, &lo, &hi);
+    p[0] = (p[0] & ~mask) | lo;
+    p[__NATIVE_PLANE] = (p[__NATIVE_PLANE] & ~mask) | hi;
+}
+#endif
+
+#ifndef PBL_BW
+/*\
+|*| Compositing. Colors with an alpha of 1 or 2 are mixed into the pixel
+|*| underneath: n_graphics_prv_alpha_lut[alpha - 1][color][bg] is color's
+|*| rgb at alpha / 3 over bg's, rounded to nearest in each channel, with
+|*| the alpha bits set. Alpha 0 and 3 need no table, so it holds only the
+|*| two middle levels (8kB of flash) and a mixed pixel is a single load.
+\*/
+#define __MIX_CH(a, s, d) ((((s) & 3) * (a) + ((d) & 3) * (3 - (a)) + 1) / 3)
+#define __MIX(a, s, d) (0b11000000 | __MIX_CH(a, (s) >> 4, (d) >> 4) << 4 | \
+                        __MIX_CH(a, (s) >> 2, (d) >> 2) << 2 | __MIX_CH(a, s, d))
+#define __MIX_4(a, s, d) __MIX(a, s, d), __MIX(a, s, d + 1), __MIX(a, s, d + 2), __MIX(a, s, d + 3)
+#define __MIX_16(a, s, d) __MIX_4(a, s, d), __MIX_4(a, s, d + 4), __MIX_4(a, s, d + 8), __MIX_4(a, s, d + 12)
+#define __MIX_BG(a, s) { __MIX_16(a, s, 0), __MIX_16(a, s, 16), __MIX_16(a, s, 32), __MIX_16(a, s, 48) }
+#define __MIX_BG_4(a, s) __MIX_BG(a, s), __MIX_BG(a, s + 1), __MIX_BG(a, s + 2), __MIX_BG(a, s + 3)
+#define __MIX_BG_16(a, s) __MIX_BG_4(a, s), __MIX_BG_4(a, s + 4), __MIX_BG_4(a, s + 8), __MIX_BG_4(a, s + 12)
+#define __MIX_ALPHA(a) { __MIX_BG_16(a, 0), __MIX_BG_16(a, 16), __MIX_BG_16(a, 32), __MIX_BG_16(a, 48) }
+
+const uint8_t n_graphics_prv_alpha_lut[2][64][64] = { __MIX_ALPHA(1), __MIX_ALPHA(2) };
+
+// Mixes a translucent fill into n pixels, stride bytes apart.
+static void n_graphics_prv_mix_run(uint8_t * p, uint16_t n, uint16_t stride, uint8_t fill) {
+    if (fill < 0b01000000)
+        return;
+    const uint8_t * mix = n_graphics_prv_alpha_lut[(fill >> 6) - 1][fill & 0b111111];
+    for (; n; n--, p += stride)
+        *p = mix[*p & 0b111111];
+}
+#endif
+
+void n_graphics_set_pixel(n_GContext * ctx, n_GPoint p, n_GColor color) {
+    // pixels (text, bitmaps) aren't recorded, so what is has to go first
+    if (ctx->deferred)
+        n_graphics_context_flush(ctx);
+#ifndef PBL_BW
+    if (color.argb < 0b01000000)
+        return;
+    if (color.argb < 0b11000000)
+        color.argb = __ALPHA_MIX(color.argb, n_graphics_prv_get_pixel(ctx->fbuf, p.x, p.y));
+#endif
+#ifdef DISPLAY_NATIVE_FRAMEBUFFER
+    n_graphics_prv_native_set(ctx->fbuf, p.x, p.y, color.argb);
+#elif defined(PBL_BW)
     n_graphics_prv_setbit(
         &ctx->fbuf[p.y * __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT + p.x / 8],
         p.x % 8, (color.argb & 0b111111));
@@ -35,6 +141,55 @@ void n_graphics_set_pixel(n_GContext * ctx, n_GPoint p, n_GColor color) {
 #endif
 }
 
+#ifndef PBL_BW
+uint8_t n_graphics_prv_get_pixel(uint8_t * fb, int16_t x, int16_t y) {
+#ifdef DISPLAY_NATIVE_FRAMEBUFFER
+    uint8_t * p = fb + __NATIVE_OFFSET(x, y);
+    if (y & 1)
+        return 0b11000000 | (p[0] & 0b00101010) | ((p[__NATIVE_PLANE] & 0b00101010) >> 1);
+    return 0b11000000 | ((p[0] & 0b00010101) << 1) | (p[__NATIVE_PLANE] & 0b00010101);
+#else
+    return fb[y * __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT + x];
+#endif
+}
+
+void n_graphics_prv_blend_pixel(uint8_t * fb, int16_t x, int16_t y,
+        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy,
+        uint8_t color, uint8_t coverage) {
+    if (x < minx || x >= maxx || y < miny || y >= maxy)
+        return;
+    // argb2222 only has four levels per channel, so four coverages do.
+    // The color's own alpha scales the coverage.
+    uint8_t c = (coverage * (color >> 6) + 127) / 255;
+    if (c == 0)
+        return;
+    if (c < 3)
+        color = n_graphics_prv_alpha_lut[c - 1][color & 0b111111]
+                                        [n_graphics_prv_get_pixel(fb, x, y) & 0b111111];
+#ifdef DISPLAY_NATIVE_FRAMEBUFFER
+    n_graphics_prv_native_set(fb, x, y, color);
+#else
+    fb[y * __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT + x] = color;
+#endif
+}
+#endif
+
+uint32_t n_graphics_prv_int_sqrt(uint32_t in) {
+    uint32_t res = 0, bit = 1u << 30;
+    while (bit > in)
+        bit >>= 2;
+    while (bit) {
+        if (in >= res + bit) {
+            in -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
 void n_graphics_draw_pixel(n_GContext * ctx, n_GPoint p) {
     n_graphics_set_pixel(ctx, p, ctx->stroke_color);
 }
@@ -44,13 +199,67 @@ void n_graphics_prv_draw_col(uint8_t * fb,
         int16_t x, int16_t top, int16_t bottom,
         int16_t minx, int16_t maxx, int16_t miny, int16_t maxy,
         uint8_t fill) {
-    if (x < minx || x >= maxx || top >= maxy || bottom < miny || bottom < top) {
+    // an empty clip (maxy == miny) would otherwise bound end below begin
+    if (x < minx || x >= maxx || top >= maxy || bottom < miny || bottom < top || maxy <= miny) {
+        return;
+    }
+
+#ifdef PBL_ROUND
+    // don't touch pixels the display can't show
+    if (x < 0 || x >= __SCREEN_WIDTH) {
+        return;
+    }
+    if (miny < __SCREEN_INSET(x))
+        miny = __SCREEN_INSET(x);
+    if (maxy > __SCREEN_HEIGHT - __SCREEN_INSET(x))
+        maxy = __SCREEN_HEIGHT - __SCREEN_INSET(x);
+    if (top >= maxy || bottom < miny || maxy <= miny) {
         return;
     }
+#endif
 
     uint16_t begin = __BOUND_NUM(miny, top, maxy - 1),
              end   = __BOUND_NUM(miny, bottom, maxy - 1);
 
+#ifdef DISPLAY_NATIVE_FRAMEBUFFER
+    if (fill < 0b11000000) {
+        // translucent, every pixel depends on what was there
+        if (fill >= 0b01000000)
+            for (uint16_t y = begin; y <= end; y++)
+                n_graphics_prv_native_set(fb, x, y,
+                    __ALPHA_MIX(fill, n_graphics_prv_get_pixel(fb, x, y)));
+        return;
+    }
+    // a column is contiguous here. Odd ends share their byte with a
+    // pixel outside the run, everything between is whole bytes
+    if (begin & 1) {
+        n_graphics_prv_native_set(fb, x, begin, fill);
+        begin++;
+    }
+    if (!(end & 1) && end >= begin) {
+        n_graphics_prv_native_set(fb, x, end, fill);
+        if (end == 0)
+            return;
+        end--;
+    }
+    if (begin < end) {
+        uint8_t lo = ((fill >> 1) & 0b00010101) | (fill & 0b00101010),
+                hi = (fill & 0b00010101) | ((fill << 1) & 0b00101010);
+        uint8_t * p = fb + __NATIVE_OFFSET(x, end);
+        uint16_t n = (end - begin + 1) / 2;
+        memset(p, lo, n);
+        memset(p + __NATIVE_PLANE, hi, n);
+    }
+    return;
+#endif
+
+#ifndef PBL_BW
+    if (fill < 0b11000000) {
+        n_graphics_prv_mix_run(fb + begin * __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT + x,
+                               end - begin + 1, __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT, fill);
+        return;
+    }
+#endif
     for (uint16_t y = begin; y <= end; y++) {
 #ifdef PBL_BW
         n_graphics_prv_setbit(&fb[y * __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT + x / 8],
@@ -66,56 +275,107 @@ void n_graphics_prv_draw_row(uint8_t * fb,
         int16_t minx, int16_t maxx, int16_t miny, int16_t maxy,
         uint8_t fill) {
     uint8_t * row;
-    if (y >= miny && y < maxy && right >= minx && left < maxx) {
+    if (y >= miny && y < maxy && right >= minx && left < maxx && right >= left && maxx > minx) {
         row = fb + (y * __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT);
     } else {
         return;
     }
 
+#ifdef PBL_ROUND
+    // only fill the visible span of the row
+    if (y < 0 || y >= __SCREEN_HEIGHT) {
+        return;
+    }
+    if (minx < __SCREEN_INSET(y))
+        minx = __SCREEN_INSET(y);
+    if (maxx > __SCREEN_WIDTH - __SCREEN_INSET(y))
+        maxx = __SCREEN_WIDTH - __SCREEN_INSET(y);
+    if (right < minx || left >= maxx || maxx <= minx) {
+        return;
+    }
+#endif
+
     uint16_t begin = __BOUND_NUM(minx, left, maxx - 1),
              end   = __BOUND_NUM(minx, right, maxx - 1);
 
+#ifdef DISPLAY_NATIVE_FRAMEBUFFER
+    // each pixel of a row is in a different column, so it is a strided
+    // read-modify-write, but every pixel shares the same bits
+    uint8_t mask, lo, hi;
+    uint8_t * p = fb + __NATIVE_OFFSET(begin, y);
+
+    (void)row;
+    if (fill < 0b11000000) {
+        if (fill >= 0b01000000)
+            for (uint16_t x = begin; x <= end; x++)
+                n_graphics_prv_native_set(fb, x, y,
+                    __ALPHA_MIX(fill, n_graphics_prv_get_pixel(fb, x, y)));
+        return;
+    }
+    n_graphics_prv_native_bits(fill, y, &mask, &lo, &hi);
+    for (uint16_t x = begin; x <= end; x++) {
+        p[0] = (p[0] & ~mask) | lo;
+        p[__NATIVE_PLANE] = (p[__NATIVE_PLANE] & ~mask) | hi;
+        p += __SCREEN_HEIGHT;
+    }
+    return;
+#endif
+
 #ifdef PBL_BW
-    uint16_t begin_byte = begin / 8,
-             end_byte   = end / 8;
+    uint32_t first_mask, last_mask;
+    if (y & 1)
+        fill = fill >> 1 | fill << 7;
+    n_graphics_prv_bw_span_masks(begin, end, &first_mask, &last_mask);
+    n_graphics_prv_bw_fill_span(row, begin, end, first_mask, last_mask, fill * 0x01010101u);
 #else
-    uint16_t begin_byte = begin,
-             end_byte   = end;
+    if (fill < 0b11000000)
+        n_graphics_prv_mix_run(row + begin, end - begin + 1, 1, fill);
+    else
+        memset(row + begin, fill, end - begin + 1);
 #endif
+}
+
+void n_graphics_prv_draw_rows(uint8_t * fb,
+        int16_t top, int16_t bottom, int16_t left, int16_t right,
+        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy,
+        uint8_t fill) {
+#if defined(PBL_ROUND) || defined(DISPLAY_NATIVE_FRAMEBUFFER)
+    // every row is clipped or laid out differently, so there is nothing
+    // to share between them
+    for (int16_t y = top; y <= bottom; y++)
+        n_graphics_prv_draw_row(fb, y, left, right, minx, maxx, miny, maxy, fill);
+#else
+    if (bottom < miny || top >= maxy || bottom < top || maxy <= miny ||
+            right < minx || left >= maxx || right < left || maxx <= minx)
+        return;
 
+    uint16_t begin = __BOUND_NUM(minx, left, maxx - 1),
+             end   = __BOUND_NUM(minx, right, maxx - 1),
+             first = __BOUND_NUM(miny, top, maxy - 1),
+             last  = __BOUND_NUM(miny, bottom, maxy - 1);
+    uint8_t * row = fb + first * __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT;
 
 #ifdef PBL_BW
-    if (y & 1)
-        fill = fill >> 1 | fill << 7;
-    /*\ Brace yourselves.
-    |*| Here's what's going on:
-    |*| - We're on b/w, which means, 8 pixels horizontally are represented by
-    |*|   1 byte of memory.
-    |*| - For maximum write speed, we're grouping two rows of equal width
-    |*|   (because we're drawing circles/ellipses) and rendering them
-    |*|   concurrently.
-    |*| - The quickest way to do that is to check:
-    |*|   - Does the full row fit within exectly one bit storage space?
-    |*|     - If so, iterate over pixels in row and set bits accordingly.
-    |*|     - Otherwise, iterate over pixels in first and last byte of the row
-    |*|       and memset everything in between.
-    \*/
-    if (begin_byte == end_byte) {
-        for (int16_t i = begin; i <= end; i++) {
-            n_graphics_prv_setbit(&row[end_byte], i - end_byte * 8, (fill >> (i%8)) & 1);
-        }
-    } else {
-        for (int16_t i = begin; i <= begin_byte * 8 + 8; i++) {
-            n_graphics_prv_setbit(&row[begin_byte], i - begin_byte * 8, (fill >> (i%8)) & 1);
-        }
-        if (end_byte - begin_byte > 1) {
-            memset(row + begin_byte + 1, fill, end_byte - begin_byte - 1);
-        }
-        for (int16_t i = end; i >= end_byte * 8; i--) {
-            n_graphics_prv_setbit(&row[end_byte], i - end_byte * 8, (fill >> (i%8)) & 1);
-        }
-    }
+    uint32_t first_mask, last_mask,
+             pattern = fill * 0x01010101u,
+             odd_pattern = (uint8_t) (fill >> 1 | fill << 7) * 0x01010101u;
+    n_graphics_prv_bw_span_masks(begin, end, &first_mask, &last_mask);
+    for (uint16_t y = first; y <= last; y++, row += __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT)
+        n_graphics_prv_bw_fill_span(row, begin, end, first_mask, last_mask,
+                                    (y & 1) ? odd_pattern : pattern);
 #else
-    memset(row + begin_byte, fill, end_byte - begin_byte + 1);
+    if (fill < 0b11000000) {
+        for (uint16_t y = first; y <= last; y++, row += __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT)
+            n_graphics_prv_mix_run(row + begin, end - begin + 1, 1, fill);
+        return;
+    }
+    if (begin == 0 && end == __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT - 1) {
+        // whole rows are one contiguous block
+        memset(row, fill, (last - first + 1) * __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT);
+        return;
+    }
+    for (uint16_t y = first; y <= last; y++, row += __SCREEN_FRAMEBUFFER_ROW_BYTE_AMOUNT)
+        memset(row + begin, fill, end - begin + 1);
+#endif
 #endif
 }
@@ -40,6 +40,9 @@ void n_graphics_set_pixel(n_GContext * ctx, n_GPoint p, n_GColor color);
 void n_graphics_fill_pixel(n_GContext * ctx, n_GPoint p);
 void n_graphics_draw_pixel(n_GContext * ctx, n_GPoint p);
 
+// floor(sqrt(in))
+uint32_t n_graphics_prv_int_sqrt(uint32_t in);
+
 void n_graphics_prv_draw_col(uint8_t * fb,
         int16_t x, int16_t top, int16_t bottom,
         int16_t minx, int16_t maxx, int16_t miny, int16_t maxy,
@@ -48,3 +51,32 @@ void n_graphics_prv_draw_row(uint8_t * fb,
     int16_t y, int16_t left, int16_t right,
     int16_t minx, int16_t maxx, int16_t miny, int16_t maxy,
     uint8_t fill);
+// Fills rows top..bottom from left to right, sharing the clipping and edge
+// masks between rows.
+void n_graphics_prv_draw_rows(uint8_t * fb,
+    int16_t top, int16_t bottom, int16_t left, int16_t right,
+    int16_t minx, int16_t maxx, int16_t miny, int16_t maxy,
+    uint8_t fill);
+
+#ifndef PBL_BW
+/*\
+|*| On 8-bit targets every routine above composites: colors with alpha 0
+|*| draw nothing, alpha 1 and 2 are mixed into the framebuffer through
+|*| n_graphics_prv_alpha_lut, alpha 3 overwrites. Primitives should touch
+|*| each pixel once, or translucent shapes come out uneven.
+\*/
+extern const uint8_t n_graphics_prv_alpha_lut[2][64][64];
+// color (alpha 1 or 2) over bg
+#define __ALPHA_MIX(color, bg) \
+    (n_graphics_prv_alpha_lut[((color) >> 6) - 1][(color) & 0b111111][(bg) & 0b111111])
+
+/*\
+|*| Anti-aliasing helpers for 8-bit targets. coverage runs from 0 (leave the
+|*| pixel alone) to 255 (plain draw of color), on top of color's own alpha.
+|*| Pixels outside the bounds are skipped.
+\*/
+uint8_t n_graphics_prv_get_pixel(uint8_t * fb, int16_t x, int16_t y);
+void n_graphics_prv_blend_pixel(uint8_t * fb, int16_t x, int16_t y,
+    int16_t minx, int16_t maxx, int16_t miny, int16_t maxy,
+    uint8_t color, uint8_t coverage);
+#endif
@@ -20,6 +20,7 @@
 \*/
 
 #include "context.h"
+#include "macros.h"
 
 // TODO optimization: calculate bytefill when color is set.
 
@@ -54,6 +55,41 @@ void n_graphics_context_set_stroke_caps(n_GContext * ctx, bool stroke_caps) {
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+void n_graphics_context_push_clip(n_GContext * ctx, n_GRect rect) {
+    rect = n_grect_standardize(rect);
+    int16_t x0 = __BOUND_NUM(ctx->clip.origin.x, rect.origin.x,
+                             ctx->clip.origin.x + ctx->clip.size.w),
+            y0 = __BOUND_NUM(ctx->clip.origin.y, rect.origin.y,
+                             ctx->clip.origin.y + ctx->clip.size.h),
+            x1 = __BOUND_NUM(x0, rect.origin.x + rect.size.w,
+                             ctx->clip.origin.x + ctx->clip.size.w),
+            y1 = __BOUND_NUM(y0, rect.origin.y + rect.size.h,
+                             ctx->clip.origin.y + ctx->clip.size.h);
+
+    // Past the end of the stack we keep narrowing but can't restore, so
+    // the clip only ever errs on the small side until the pops catch up.
+    if (ctx->clip_depth < N_GRAPHICS_CLIP_STACK_DEPTH)
+        ctx->clip_stack[ctx->clip_depth] = ctx->clip;
+    ctx->clip_depth++;
+
+    ctx->clip = n_GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void n_graphics_context_pop_clip(n_GContext * ctx) {
+    if (ctx->clip_depth == 0)
+        return;
+    ctx->clip_depth--;
+    if (ctx->clip_depth < N_GRAPHICS_CLIP_STACK_DEPTH)
+        ctx->clip = ctx->clip_stack[ctx->clip_depth];
+}
+
+void n_graphics_context_reset_clip(n_GContext * ctx) {
+    ctx->clip_depth = 0;
+    ctx->clip = n_GRect(0, 0, __SCREEN_WIDTH, __SCREEN_HEIGHT);
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
 void n_graphics_context_begin(n_GContext * ctx) {
 #ifndef NGFX_IS_CORE 
     if (ctx->underlying_context) {
@@ -114,6 +150,9 @@ static n_GContext * n_graphics_context_create() {
     n_graphics_context_set_stroke_caps(out, true);
     n_graphics_context_set_antialiased(out, true);
     n_graphics_context_set_stroke_width(out, 1);
+    n_graphics_context_reset_clip(out);
+    out->deferred = false;
+    out->display_list = NULL;
     return out;
 }
 
@@ -132,5 +171,6 @@ n_GContext * n_graphics_context_from_graphics_context(uint8_t * ctx) {
 #endif
 
 void n_graphics_context_destroy(n_GContext * ctx) {
+    free(ctx->display_list);
     free(ctx);
 }
@@ -40,6 +40,11 @@
  */
 
 
+/*!
+ * How many clip rectangles n_graphics_context_push_clip() can save.
+ */
+#define N_GRAPHICS_CLIP_STACK_DEPTH 8
+
 /*!
  * Internal representation of the graphics context itself. Created via
  * n_graphics_context_from_buffer() or
@@ -63,8 +68,21 @@ typedef struct n_GContext {
     GBitmap * bitmap;
     uint8_t * fbuf;
     n_GRect offset;
+    n_GRect clip; // in screen coordinates, never outside the screen
+    n_GRect clip_stack[N_GRAPHICS_CLIP_STACK_DEPTH];
+    uint8_t clip_depth;
+    bool deferred; // record draw calls instead, see deferred/deferred.h
+    struct n_GDisplayList * display_list;
 } n_GContext;
 
+/*!
+ * Expands to the minx, maxx, miny, maxy arguments taken by the _bounded
+ * primitives, for the context's active clip.
+ */
+#define __CLIP_BOUNDS(ctx) \
+    (ctx)->clip.origin.x, (ctx)->clip.origin.x + (ctx)->clip.size.w, \
+    (ctx)->clip.origin.y, (ctx)->clip.origin.y + (ctx)->clip.size.h
+
 /*!
  * Sets the n_GColor used to draw strokes.
  */
@@ -92,6 +110,20 @@ void n_graphics_context_set_stroke_width(n_GContext * ctx, uint16_t width);
  */
 void n_graphics_context_set_antialiased(n_GContext * ctx, bool antialias);
 
+/*!
+ * Narrows the clip to its intersection with rect (in screen coordinates)
+ * and saves the previous one. Nothing is drawn outside the clip.
+ */
+void n_graphics_context_push_clip(n_GContext * ctx, n_GRect rect);
+/*!
+ * Restores the clip saved by the matching n_graphics_context_push_clip().
+ */
+void n_graphics_context_pop_clip(n_GContext * ctx);
+/*!
+ * Drops all saved clips and clips to the whole screen.
+ */
+void n_graphics_context_reset_clip(n_GContext * ctx);
+
 /*!
  * In Pebble OS, use this before drawing to the n_GContext for contexts created
  * from a graphics context (via n_graphics_context_from_graphics_context()).
@@ -0,0 +1,300 @@
+/*\
+|*|
+|*|   Neographics: a tiny graphics library.
+|*|   Copyright (C) 2016 Johannes Neubrand <johannes_n@icloud.com>
+|*|
+|*|   This program is free software; you can redistribute it and/or
+|*|   modify it under the terms of the GNU General Public License
+|*|   as published by the Free Software Foundation; either version 2
+|*|   of the License, or (at your option) any later version.
+|*|
+|*|   This program is distributed in the hope that it will be useful,
+|*|   but WITHOUT ANY WARRANTY; without even the implied warranty of
+|*|   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|*|   GNU General Public License for more details.
+|*|
+|*|   You should have received a copy of the GNU General Public License
+|*|   along with this program; if not, write to the Free Software
+|*|   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+|*|
+\*/
+
+#include "deferred.h"
+#include "../macros.h"
+#include "../primitives/rect.h"
+#include "../primitives/circle.h"
+#include "../primitives/line.h"
+
+static n_GRect n_prv_intersect(n_GRect a, n_GRect b) {
+    int16_t x0 = __BOUND_NUM(b.origin.x, a.origin.x, b.origin.x + b.size.w),
+            y0 = __BOUND_NUM(b.origin.y, a.origin.y, b.origin.y + b.size.h),
+            x1 = __BOUND_NUM(x0, a.origin.x + a.size.w, b.origin.x + b.size.w),
+            y1 = __BOUND_NUM(y0, a.origin.y + a.size.h, b.origin.y + b.size.h);
+    return n_GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+static n_GRect n_prv_grow(n_GRect rect, int16_t by) {
+    rect = n_grect_standardize(rect);
+    return n_GRect(rect.origin.x - by, rect.origin.y - by,
+                   rect.size.w + 2 * by, rect.size.h + 2 * by);
+}
+
+/*\
+|*| Recording
+\*/
+
+// Takes the next slot in the list, flushing it first if it's full. Calls
+// that can't touch anything inside the clip aren't recorded at all.
+static n_GDeferredOp * n_prv_defer(n_GContext * ctx, n_GDeferredOpType type,
+        n_GColor color, n_GRect bounds) {
+    n_GDisplayList * list = ctx->display_list;
+    bounds = n_prv_intersect(bounds, ctx->clip);
+    if (bounds.size.w <= 0 || bounds.size.h <= 0)
+        return NULL;
+    if (list->count == N_GRAPHICS_DEFERRED_OPS)
+        n_graphics_context_flush(ctx);
+
+    n_GDeferredOp * op = &list->ops[list->count++];
+    op->type = type;
+    op->color = color;
+    op->antialias = ctx->antialias;
+    op->stroke_caps = ctx->stroke_caps;
+    op->stroke_width = ctx->stroke_width;
+    op->bounds = bounds;
+    op->opaque = n_GRect(0, 0, 0, 0);
+    list->stats.ops++;
+    return op;
+}
+
+void n_graphics_prv_defer_rect(n_GContext * ctx, n_GDeferredOpType type,
+        n_GRect rect, uint16_t radius, n_GCornerMask mask) {
+    n_GDeferredOp * op;
+    if (type == n_GDeferredOpFillRect)
+        op = n_prv_defer(ctx, type, ctx->fill_color, n_prv_grow(rect, 0));
+    else if (type == n_GDeferredOpDrawThinRect)
+        // an empty rect still puts its right side a column left of its left
+        op = n_prv_defer(ctx, type, ctx->stroke_color, n_prv_grow(rect, 1));
+    else
+        op = n_prv_defer(ctx, type, ctx->stroke_color,
+                         n_prv_grow(rect, ctx->stroke_width / 2 + 1));
+    if (!op)
+        return;
+    op->args.rect.rect = rect;
+    op->args.rect.radius = radius;
+    op->args.rect.mask = mask;
+
+    // An opaque fill hides whatever was drawn under it. With rounded
+    // corners only the rows between them are sure to be covered.
+    if (type == n_GDeferredOpFillRect && (op->color.argb >> 6) == 0b11 &&
+            rect.size.w > 0 && rect.size.h > 0) {
+        if (radius && (mask & n_GCornersAll)) {
+            uint16_t inset = __BOUND_NUM(0, radius, rect.size.h / 2);
+            rect.origin.y += inset;
+            rect.size.h -= 2 * inset;
+        }
+        op->opaque = n_prv_intersect(rect, op->bounds);
+    }
+}
+
+void n_graphics_prv_defer_line(n_GContext * ctx, n_GPoint from, n_GPoint to) {
+    int16_t x0 = from.x < to.x ? from.x : to.x,
+            y0 = from.y < to.y ? from.y : to.y;
+    n_GRect bounds = n_GRect(x0, y0, from.x + to.x - 2 * x0 + 1, from.y + to.y - 2 * y0 + 1);
+    n_GDeferredOp * op = n_prv_defer(ctx, n_GDeferredOpDrawLine, ctx->stroke_color,
+                                     n_prv_grow(bounds, ctx->stroke_width / 2 + 2));
+    if (!op)
+        return;
+    op->args.line.from = from;
+    op->args.line.to = to;
+}
+
+void n_graphics_prv_defer_circle(n_GContext * ctx, n_GDeferredOpType type,
+        n_GPoint p, uint16_t radius) {
+    bool fill = (type == n_GDeferredOpFillCircle);
+    int16_t reach = radius + (fill ? 1 : ctx->stroke_width / 2 + 2);
+    n_GDeferredOp * op = n_prv_defer(ctx, type, fill ? ctx->fill_color : ctx->stroke_color,
+        n_GRect(p.x - reach, p.y - reach, 2 * reach + 1, 2 * reach + 1));
+    if (!op)
+        return;
+    op->args.circle.p = p;
+    op->args.circle.radius = radius;
+}
+
+void n_graphics_prv_defer_arc(n_GContext * ctx, n_GDeferredOpType type,
+        n_GRect rect, n_GOvalScaleMode scale_mode, uint16_t inset_thickness,
+        int32_t angle_start, int32_t angle_end) {
+    bool fill = (type == n_GDeferredOpFillRadial);
+    int16_t reach = fill ? 1 : ctx->stroke_width / 2 + 2;
+    // a circle filling the rect hangs over its short sides
+    if (scale_mode == n_GOvalScaleModeFillCircle)
+        reach += (rect.size.w > rect.size.h ? rect.size.w - rect.size.h
+                                            : rect.size.h - rect.size.w) / 2 + 1;
+    n_GDeferredOp * op = n_prv_defer(ctx, type, fill ? ctx->fill_color : ctx->stroke_color,
+                                     n_prv_grow(rect, reach));
+    if (!op)
+        return;
+    op->args.arc.rect = rect;
+    op->args.arc.scale_mode = scale_mode;
+    op->args.arc.inset_thickness = inset_thickness;
+    op->args.arc.angle_start = angle_start;
+    op->args.arc.angle_end = angle_end;
+}
+
+/*\
+|*| Rasterizing
+\*/
+
+static void n_prv_replay(n_GContext * ctx, const n_GDeferredOp * op) {
+    ctx->stroke_color = ctx->fill_color = op->color;
+    ctx->stroke_width = op->stroke_width;
+    ctx->antialias = op->antialias;
+    ctx->stroke_caps = op->stroke_caps;
+    switch (op->type) {
+        case n_GDeferredOpFillRect:
+            n_graphics_fill_rect(ctx, op->args.rect.rect,
+                                 op->args.rect.radius, op->args.rect.mask);
+            break;
+        case n_GDeferredOpDrawRect:
+            n_graphics_draw_rect(ctx, op->args.rect.rect,
+                                 op->args.rect.radius, op->args.rect.mask);
+            break;
+        case n_GDeferredOpDrawThinRect:
+            n_graphics_draw_thin_rect(ctx, op->args.rect.rect);
+            break;
+        case n_GDeferredOpDrawLine:
+            n_graphics_draw_line(ctx, op->args.line.from, op->args.line.to);
+            break;
+        case n_GDeferredOpFillCircle:
+            n_graphics_fill_circle(ctx, op->args.circle.p, op->args.circle.radius);
+            break;
+        case n_GDeferredOpDrawCircle:
+            n_graphics_draw_circle(ctx, op->args.circle.p, op->args.circle.radius);
+            break;
+        case n_GDeferredOpDrawArc:
+            n_graphics_draw_arc(ctx, op->args.arc.rect, op->args.arc.scale_mode,
+                                op->args.arc.angle_start, op->args.arc.angle_end);
+            break;
+        case n_GDeferredOpFillRadial:
+            n_graphics_fill_radial(ctx, op->args.arc.rect, op->args.arc.scale_mode,
+                                   op->args.arc.inset_thickness,
+                                   op->args.arc.angle_start, op->args.arc.angle_end);
+            break;
+    }
+}
+
+// Cuts [*x0, *x1) back by the opaque rects recorded after op 'after' that
+// cover rows y0 .. y1 - 1. Only the ends can go: a hole in the middle
+// would take a second clip.
+static void n_prv_trim(const n_GDisplayList * list, const uint8_t * occluders,
+        uint8_t occluder_count, uint16_t after, int16_t y0, int16_t y1,
+        int16_t * x0, int16_t * x1) {
+    bool trimmed = true;
+    while (trimmed && *x0 < *x1) {
+        trimmed = false;
+        for (uint8_t i = 0; i < occluder_count; i++) {
+            if (occluders[i] <= after)
+                continue;
+            const n_GRect * o = &list->ops[occluders[i]].opaque;
+            if (o->origin.y > y0 || o->origin.y + o->size.h < y1)
+                continue;
+            int16_t o0 = o->origin.x, o1 = o->origin.x + o->size.w;
+            if (o0 <= *x0 && o1 > *x0) {
+                *x0 = o1;
+                trimmed = true;
+            }
+            if (o1 >= *x1 && o0 < *x1) {
+                *x1 = o0;
+                trimmed = true;
+            }
+        }
+    }
+}
+
+void n_graphics_context_flush(n_GContext * ctx) {
+    n_GDisplayList * list = ctx->display_list;
+    if (!list || list->count == 0)
+        return;
+
+    n_GColor stroke_color = ctx->stroke_color,
+             fill_color = ctx->fill_color;
+    uint16_t stroke_width = ctx->stroke_width;
+    bool antialias = ctx->antialias,
+         stroke_caps = ctx->stroke_caps,
+         deferred = ctx->deferred;
+    n_GRect clip = ctx->clip;
+    // the replayed calls have to draw for real
+    ctx->deferred = false;
+
+    uint8_t occluders[N_GRAPHICS_DEFERRED_OPS], occluder_count = 0;
+    for (uint16_t i = 0; i < list->count; i++)
+        if (list->ops[i].opaque.size.w > 0 && list->ops[i].opaque.size.h > 0)
+            occluders[occluder_count++] = i;
+
+    for (int16_t band = 0; band < __SCREEN_HEIGHT; band += N_GRAPHICS_DEFERRED_BAND_HEIGHT) {
+        int16_t band_end = band + N_GRAPHICS_DEFERRED_BAND_HEIGHT;
+        if (band_end > __SCREEN_HEIGHT)
+            band_end = __SCREEN_HEIGHT;
+        for (uint16_t i = 0; i < list->count; i++) {
+            const n_GDeferredOp * op = &list->ops[i];
+            int16_t y0 = op->bounds.origin.y,
+                    y1 = op->bounds.origin.y + op->bounds.size.h,
+                    x0 = op->bounds.origin.x,
+                    x1 = op->bounds.origin.x + op->bounds.size.w;
+            if (y0 < band)
+                y0 = band;
+            if (y1 > band_end)
+                y1 = band_end;
+            if (y0 >= y1)
+                continue;
+
+            list->stats.area += (x1 - x0) * (y1 - y0);
+            n_prv_trim(list, occluders, occluder_count, i, y0, y1, &x0, &x1);
+            if (x0 >= x1) {
+                list->stats.culled++;
+                continue;
+            }
+            list->stats.drawn += (x1 - x0) * (y1 - y0);
+
+            ctx->clip = n_GRect(x0, y0, x1 - x0, y1 - y0);
+            n_prv_replay(ctx, op);
+        }
+    }
+
+    list->count = 0;
+    list->stats.flushes++;
+    ctx->stroke_color = stroke_color;
+    ctx->fill_color = fill_color;
+    ctx->stroke_width = stroke_width;
+    ctx->antialias = antialias;
+    ctx->stroke_caps = stroke_caps;
+    ctx->clip = clip;
+    ctx->deferred = deferred;
+}
+
+/*\
+|*| Mode
+\*/
+
+bool n_graphics_context_begin_deferred(n_GContext * ctx) {
+    if (!ctx->display_list) {
+        ctx->display_list = malloc(sizeof(n_GDisplayList));
+        if (!ctx->display_list)
+            return false;
+        ctx->display_list->count = 0;
+    }
+    memset(&ctx->display_list->stats, 0, sizeof(n_GDeferredStats));
+    ctx->deferred = true;
+    return true;
+}
+
+void n_graphics_context_end_deferred(n_GContext * ctx) {
+    n_graphics_context_flush(ctx);
+    ctx->deferred = false;
+}
+
+void n_graphics_context_get_deferred_stats(n_GContext * ctx, n_GDeferredStats * stats) {
+    if (ctx->display_list)
+        *stats = ctx->display_list->stats;
+    else
+        memset(stats, 0, sizeof(n_GDeferredStats));
+}
@@ -0,0 +1,149 @@
+/*\
+|*|
+|*|   Neographics: a tiny graphics library.
+|*|   Copyright (C) 2016 Johannes Neubrand <johannes_n@icloud.com>
+|*|
+|*|   This program is free software; you can redistribute it and/or
+|*|   modify it under the terms of the GNU General Public License
+|*|   as published by the Free Software Foundation; either version 2
+|*|   of the License, or (at your option) any later version.
+|*|
+|*|   This program is distributed in the hope that it will be useful,
+|*|   but WITHOUT ANY WARRANTY; without even the implied warranty of
+|*|   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|*|   GNU General Public License for more details.
+|*|
+|*|   You should have received a copy of the GNU General Public License
+|*|   along with this program; if not, write to the Free Software
+|*|   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+|*|
+\*/
+
+#pragma once
+#include <pebble.h>
+#include "../context.h"
+#include "../types.h"
+
+/*-----------------------------------------------------------------------------.
+|                                                                              |
+|                              Deferred Drawing                                |
+|                                                                              |
+|   In deferred mode, rects, lines, circles and arcs aren't drawn straight     |
+|   away but recorded, with the context state they need, into a display        |
+|   list. On flush the screen is rasterized a band of rows at a time: each     |
+|   band replays the calls that touch it, back to front, clipped to the band.  |
+|   Before a call is replayed it is trimmed against the opaque fill_rects      |
+|   recorded after it, and skipped altogether when they cover it, so the       |
+|   background a full-screen layer paints over is never drawn.                 |
+|                                                                              |
+|   Anything that isn't recorded (pixels, text, bitmaps, path fills, direct    |
+|   framebuffer access) flushes the list first, so the result is always the   |
+|   same as drawing immediately.                                               |
+|                                                                              |
+`-----------------------------------------------------------------------------*/
+
+/*! \addtogroup deferred
+ *  Recording draw calls and rasterizing them a band at a time.
+ *  @{
+ */
+
+// How many calls the list holds before it has to flush.
+#define N_GRAPHICS_DEFERRED_OPS 48
+// Rows per band. Smaller bands cull more, but replay each call more often.
+#define N_GRAPHICS_DEFERRED_BAND_HEIGHT 16
+
+typedef enum {
+    n_GDeferredOpFillRect,
+    n_GDeferredOpDrawRect,
+    n_GDeferredOpDrawThinRect,
+    n_GDeferredOpDrawLine,
+    n_GDeferredOpFillCircle,
+    n_GDeferredOpDrawCircle,
+    n_GDeferredOpDrawArc,
+    n_GDeferredOpFillRadial,
+} n_GDeferredOpType;
+
+/*!
+ * One recorded call. bounds holds every pixel it may touch, already
+ * clipped; opaque is the part it is sure to cover with an opaque color
+ * (empty unless it's an opaque fill_rect).
+ */
+typedef struct {
+    uint8_t type;
+    bool antialias;
+    bool stroke_caps;
+    n_GColor color;
+    uint16_t stroke_width;
+    n_GRect bounds;
+    n_GRect opaque;
+    union {
+        struct {
+            n_GRect rect;
+            uint16_t radius;
+            n_GCornerMask mask;
+        } rect;
+        struct {
+            n_GPoint from, to;
+        } line;
+        struct {
+            n_GPoint p;
+            uint16_t radius;
+        } circle;
+        struct {
+            n_GRect rect;
+            n_GOvalScaleMode scale_mode;
+            uint16_t inset_thickness;
+            int32_t angle_start, angle_end;
+        } arc;
+    } args;
+} n_GDeferredOp;
+
+/*!
+ * What deferred mode saved since it was begun. area and drawn are summed
+ * over bands, in pixels of each call's bounds.
+ */
+typedef struct {
+    uint32_t ops;     // calls recorded
+    uint32_t flushes; // times the list was rasterized
+    uint32_t culled;  // band replays skipped because something opaque covered them
+    uint32_t area;    // pixels the recorded calls would have touched
+    uint32_t drawn;   // of those, pixels left after occlusion
+} n_GDeferredStats;
+
+typedef struct n_GDisplayList {
+    uint16_t count;
+    n_GDeferredStats stats;
+    n_GDeferredOp ops[N_GRAPHICS_DEFERRED_OPS];
+} n_GDisplayList;
+
+/*!
+ * Starts recording draw calls on ctx and clears its stats. The list is
+ * allocated on first use and kept until the context is destroyed. Returns
+ * false (and keeps drawing immediately) if there was no memory for it.
+ */
+bool n_graphics_context_begin_deferred(n_GContext * ctx);
+/*!
+ * Rasterizes everything recorded so far. Recording carries on.
+ */
+void n_graphics_context_flush(n_GContext * ctx);
+/*!
+ * Flushes, then goes back to drawing immediately.
+ */
+void n_graphics_context_end_deferred(n_GContext * ctx);
+/*!
+ * Copies out what deferred mode saved since n_graphics_context_begin_deferred().
+ */
+void n_graphics_context_get_deferred_stats(n_GContext * ctx, n_GDeferredStats * stats);
+
+// Used by the primitives to record themselves while ctx->deferred is set.
+void n_graphics_prv_defer_rect(n_GContext * ctx, n_GDeferredOpType type,
+    n_GRect rect, uint16_t radius, n_GCornerMask mask);
+void n_graphics_prv_defer_line(n_GContext * ctx, n_GPoint from, n_GPoint to);
+void n_graphics_prv_defer_circle(n_GContext * ctx, n_GDeferredOpType type,
+    n_GPoint p, uint16_t radius);
+void n_graphics_prv_defer_arc(n_GContext * ctx, n_GDeferredOpType type,
+    n_GRect rect, n_GOvalScaleMode scale_mode, uint16_t inset_thickness,
+    int32_t angle_start, int32_t angle_end);
+
+/*! @}
+ */
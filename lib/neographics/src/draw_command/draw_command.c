@@ -20,6 +20,7 @@
 \*/
 
 #include "draw_command.h"
+#include "../deferred/deferred.h"
 
 /*\
 |*| Note that the files aren't actually fully persisted in memory.
@@ -88,50 +89,75 @@ void n_gdraw_command_set_hidden(n_GDrawCommand * command, bool hidden) {
 
 /* draw: defined for image / frame / sequence */
 
-void n_gdraw_command_draw(n_GContext * ctx, n_GDrawCommand * command, n_GPoint offset) {
+// The colors a command is drawn with on this screen.
+static void n_prv_gdraw_command_colors(n_GDrawCommand * command,
+                                       n_GColor * stroke_color, n_GColor * fill_color) {
 #ifdef PBL_BW
     static const uint8_t bw_lookup[] = {0b00000000, 0b11101010, 0b11000000, 0b11111111};
     if (command->flags.use_bw_color) {
-        n_graphics_context_set_stroke_color(ctx, (n_GColor) { .argb = bw_lookup[command->flags.bw_stroke & 0b11] });
-        n_graphics_context_set_fill_color(ctx, (n_GColor) { .argb = bw_lookup[command->flags.bw_fill & 0b11] });
-    } else {
-#endif
-        n_graphics_context_set_stroke_color(ctx, command->stroke_color);
-        n_graphics_context_set_fill_color(ctx, command->fill_color);
-#ifdef PBL_BW
+        *stroke_color = (n_GColor) { .argb = bw_lookup[command->flags.bw_stroke & 0b11] };
+        *fill_color = (n_GColor) { .argb = bw_lookup[command->flags.bw_fill & 0b11] };
+        return;
     }
 #endif
+    *stroke_color = command->stroke_color;
+    *fill_color = command->fill_color;
+}
+
+void n_gdraw_command_draw(n_GContext * ctx, n_GDrawCommand * command, n_GPoint offset) {
+    n_GColor stroke_color, fill_color;
+    n_prv_gdraw_command_colors(command, &stroke_color, &fill_color);
+    n_graphics_context_set_stroke_color(ctx, stroke_color);
+    n_graphics_context_set_fill_color(ctx, fill_color);
     n_graphics_context_set_stroke_width(ctx, command->stroke_width);
+    // Paths are drawn from a moved copy of their points. Precise points
+    // are in eighths of a pixel, so the offset is scaled to match.
+    n_GPoint * points = command->points;
+    if ((offset.x || offset.y) && (command->type == n_GDrawCommandTypePath ||
+                                   command->type == n_GDrawCommandTypePrecisePath)) {
+        int16_t scale = command->type == n_GDrawCommandTypePrecisePath ? 8 : 1;
+        points = malloc(sizeof(n_GPoint) * command->num_points);
+        if (!points)
+            return;
+        for (uint32_t i = 0; i < command->num_points; i++)
+            points[i] = n_GPoint(command->points[i].x + offset.x * scale,
+                                 command->points[i].y + offset.y * scale);
+    }
     // Note that fill_path and draw_path (and their ppath equivalents)
     // are private apis. Therefore, they currently ignore the alpha component.
     switch (command->type) {
         case n_GDrawCommandTypePath:
             if (ctx->fill_color.argb & (0b11 << 6))
-                n_graphics_fill_path(ctx, command->num_points, command->points);
+                n_graphics_fill_path(ctx, command->num_points, points);
             if (ctx->stroke_color.argb & (0b11 << 6))
-                n_graphics_draw_path(ctx, command->num_points, command->points, command->path_flags.path_open);
+                n_graphics_draw_path(ctx, command->num_points, points, command->path_flags.path_open);
             break;
         case n_GDrawCommandTypeCircle:
             for (uint32_t i = 0; i < command->num_points; i++) {
-                n_graphics_fill_circle(ctx, command->points[i], command->circle_radius);
-                n_graphics_draw_circle(ctx, command->points[i], command->circle_radius);
+                n_GPoint p = n_GPoint(command->points[i].x + offset.x, command->points[i].y + offset.y);
+                n_graphics_fill_circle(ctx, p, command->circle_radius);
+                n_graphics_draw_circle(ctx, p, command->circle_radius);
             }
             break;
         case n_GDrawCommandTypePrecisePath:
             if (ctx->fill_color.argb & (0b11 << 6))
-                n_graphics_fill_ppath(ctx, command->num_points, command->points);
+                n_graphics_fill_ppath(ctx, command->num_points, points);
             if (ctx->stroke_color.argb & (0b11 << 6))
-                n_graphics_draw_ppath(ctx, command->num_points, command->points, command->path_flags.path_open);
+                n_graphics_draw_ppath(ctx, command->num_points, points, command->path_flags.path_open);
             break;
         case n_GDrawCommandTypePreciseCircle:
             for (uint32_t i = 0; i < command->num_points; i++) {
-                n_graphics_fill_circle(ctx, n_GPoint((command->points[i].x + 4) >> 3, (command->points[i].y + 4) >> 3), command->circle_radius);
-                n_graphics_draw_circle(ctx, n_GPoint((command->points[i].x + 4) >> 3, (command->points[i].y + 4) >> 3), command->circle_radius);
+                n_GPoint p = n_GPoint(((command->points[i].x + 4) >> 3) + offset.x,
+                                      ((command->points[i].y + 4) >> 3) + offset.y);
+                n_graphics_fill_circle(ctx, p, command->circle_radius);
+                n_graphics_draw_circle(ctx, p, command->circle_radius);
             }
             break;
         default:
             break;
     }
+    if (points != command->points)
+        free(points);
 }
 
 void n_gdraw_command_image_draw(n_GContext * ctx, n_GDrawCommandImage * image, n_GPoint offset) {
@@ -160,6 +186,133 @@ void n_gdraw_command_list_draw(n_GContext * ctx, n_GDrawCommandList * list, n_GP
     app_free(context);
 }
 
+/* compiled lists */
+
+static bool n_prv_gdraw_command_is_path(n_GDrawCommand * command) {
+    return command->type == n_GDrawCommandTypePath ||
+           command->type == n_GDrawCommandTypePrecisePath;
+}
+
+static bool n_prv_gdraw_command_fills_path(n_GDrawCommand * command) {
+    n_GColor stroke_color, fill_color;
+    n_prv_gdraw_command_colors(command, &stroke_color, &fill_color);
+    return n_prv_gdraw_command_is_path(command) && (fill_color.argb & (0b11 << 6));
+}
+
+n_GDrawCommandCompiled * n_gdraw_command_list_compile(n_GDrawCommandList * list) {
+    // Size everything up first, the ops, edge tables and points share one
+    // block. A path has at most one edge per point. Every command gets an
+    // op, even one that draws nothing: it still sets the colors and stroke
+    // width the commands after it may go on with.
+    // The fills step through a copy of their edge table, so the block
+    // also has room for a copy of the largest one.
+    uint32_t num_ops = list->num_commands, num_points = 0, num_edges = 0, max_edges = 0;
+    n_GDrawCommand * cmd = list->commands;
+    for (uint32_t i = 0; i < list->num_commands; i++) {
+        num_points += cmd->num_points;
+        if (n_prv_gdraw_command_fills_path(cmd)) {
+            num_edges += cmd->num_points;
+            if (cmd->num_points > max_edges)
+                max_edges = cmd->num_points;
+        }
+        cmd = (n_GDrawCommand *) (cmd->points + cmd->num_points);
+    }
+
+    // it belongs to the app, so it goes when the app does
+    n_GDrawCommandCompiled * compiled = app_malloc(sizeof(n_GDrawCommandCompiled) +
+                                               sizeof(n_GDrawCommandCompiledOp) * num_ops +
+                                               sizeof(n_GPathEdge) * (num_edges + max_edges) +
+                                               sizeof(n_GPoint) * num_points);
+    if (!compiled)
+        return NULL;
+    n_GPathEdge * edges = (n_GPathEdge *) (compiled->ops + num_ops);
+    compiled->scratch = edges + num_edges;
+    n_GPoint * points = (n_GPoint *) (compiled->scratch + max_edges);
+    compiled->num_ops = num_ops;
+
+    cmd = list->commands;
+    for (uint32_t i = 0; i < list->num_commands; i++) {
+        n_GDrawCommandCompiledOp * op = &compiled->ops[i];
+        bool precise = cmd->type == n_GDrawCommandTypePrecisePath ||
+                       cmd->type == n_GDrawCommandTypePreciseCircle;
+        if (n_prv_gdraw_command_is_path(cmd))
+            op->type = n_GDrawCommandTypePath;
+        else if (cmd->type == n_GDrawCommandTypeCircle || precise)
+            op->type = n_GDrawCommandTypeCircle;
+        else
+            op->type = n_GDrawCommandTypeInvalid;
+        n_prv_gdraw_command_colors(cmd, &op->stroke_color, &op->fill_color);
+        op->stroke_width = cmd->stroke_width;
+        op->path_open = op->type == n_GDrawCommandTypePath && cmd->path_flags.path_open;
+        op->circle_radius = op->type == n_GDrawCommandTypeCircle ? cmd->circle_radius : 0;
+        op->num_points = cmd->num_points;
+        op->points = points;
+        for (uint16_t k = 0; k < cmd->num_points; k++)
+            points[k] = precise ? n_GPoint((cmd->points[k].x + 4) >> 3, (cmd->points[k].y + 4) >> 3)
+                                : cmd->points[k];
+        points += cmd->num_points;
+
+        op->num_edges = 0;
+        op->lowest = 0;
+        op->edges = edges;
+        if (n_prv_gdraw_command_fills_path(cmd)) {
+            op->num_edges = n_graphics_prv_path_edges(cmd->num_points, cmd->points, precise,
+                                                      edges, &op->lowest);
+            edges += op->num_edges;
+        }
+        cmd = (n_GDrawCommand *) (cmd->points + cmd->num_points);
+    }
+    return compiled;
+}
+
+n_GDrawCommandCompiled * n_gdraw_command_image_compile(n_GDrawCommandImage * image) {
+    return n_gdraw_command_list_compile(n_gdraw_command_image_get_command_list(image));
+}
+
+void n_gdraw_command_compiled_draw(n_GContext * ctx, n_GDrawCommandCompiled * compiled, n_GPoint offset) {
+    n_GPathEdge * edges = compiled->scratch;
+    for (uint16_t i = 0; i < compiled->num_ops; i++) {
+        n_GDrawCommandCompiledOp * op = &compiled->ops[i];
+        n_graphics_context_set_stroke_color(ctx, op->stroke_color);
+        n_graphics_context_set_fill_color(ctx, op->fill_color);
+        n_graphics_context_set_stroke_width(ctx, op->stroke_width);
+
+        if (op->type == n_GDrawCommandTypeCircle) {
+            for (uint16_t k = 0; k < op->num_points; k++) {
+                n_GPoint p = n_GPoint(op->points[k].x + offset.x, op->points[k].y + offset.y);
+                n_graphics_fill_circle(ctx, p, op->circle_radius);
+                n_graphics_draw_circle(ctx, p, op->circle_radius);
+            }
+            continue;
+        }
+
+        if (op->type != n_GDrawCommandTypePath)
+            continue;
+        if (op->num_edges) {
+            // the fill steps through the table, so it gets the copy. Like
+            // n_graphics_fill_path it isn't recorded when deferring.
+            memcpy(edges, op->edges, sizeof(n_GPathEdge) * op->num_edges);
+            n_graphics_context_flush(ctx);
+            n_graphics_prv_fill_edges(ctx, edges, op->num_edges, op->lowest, offset,
+                                      __CLIP_BOUNDS(ctx));
+        }
+        if ((ctx->stroke_color.argb & (0b11 << 6)) && op->num_points) {
+            n_GPoint * p = op->points;
+            for (uint16_t k = 0; k + 1 < op->num_points; k++)
+                n_graphics_draw_line(ctx, n_GPoint(p[k].x + offset.x, p[k].y + offset.y),
+                                     n_GPoint(p[k + 1].x + offset.x, p[k + 1].y + offset.y));
+            if (!op->path_open)
+                n_graphics_draw_line(ctx,
+                    n_GPoint(p[op->num_points - 1].x + offset.x, p[op->num_points - 1].y + offset.y),
+                    n_GPoint(p[0].x + offset.x, p[0].y + offset.y));
+        }
+    }
+}
+
+void n_gdraw_command_compiled_destroy(n_GDrawCommandCompiled * compiled) {
+    app_free(compiled);
+}
+
 /* command list getters */
 
 n_GDrawCommandList * n_gdraw_command_image_get_command_list(n_GDrawCommandImage * image) {
@@ -149,6 +149,42 @@ void     n_gdraw_command_image_draw(n_GContext * ctx, n_GDrawCommandImage * imag
 void     n_gdraw_command_frame_draw(n_GContext * ctx, n_GDrawCommandSequence * sequence, n_GDrawCommandFrame * frame, n_GPoint offset);
 void     n_gdraw_command_list_draw(n_GContext * ctx, n_GDrawCommandList * list, n_GPoint offset);
 
+/* compiled lists */
+
+/*
+ * A command list decoded ahead of time for drawing it again and again.
+ * Commands are unpacked into aligned ops with their colors already picked
+ * for the screen, precise points rounded to pixels, and the edge table of
+ * each filled path built once, so a draw only has to replay them. The
+ * compiled list is a copy: changes to the image afterwards aren't seen,
+ * compile it again instead. It draws the same as n_gdraw_command_list_draw.
+ * The caller owns it and frees it with n_gdraw_command_compiled_destroy.
+ */
+typedef struct {
+    n_GDrawCommandType type; // n_GDrawCommandTypePath or n_GDrawCommandTypeCircle
+    n_GColor stroke_color;
+    n_GColor fill_color;
+    uint8_t stroke_width;
+    bool path_open;
+    uint16_t circle_radius;
+    uint16_t num_points;
+    uint16_t num_edges; // 0 unless the path is filled
+    int16_t lowest;
+    n_GPoint * points;
+    n_GPathEdge * edges;
+} n_GDrawCommandCompiledOp;
+
+typedef struct {
+    uint16_t num_ops;
+    n_GPathEdge * scratch; // room for the largest edge table, used by draws
+    n_GDrawCommandCompiledOp ops[];
+} n_GDrawCommandCompiled;
+
+n_GDrawCommandCompiled * n_gdraw_command_list_compile(n_GDrawCommandList * list);
+n_GDrawCommandCompiled * n_gdraw_command_image_compile(n_GDrawCommandImage * image);
+void n_gdraw_command_compiled_draw(n_GContext * ctx, n_GDrawCommandCompiled * compiled, n_GPoint offset);
+void n_gdraw_command_compiled_destroy(n_GDrawCommandCompiled * compiled);
+
 /* command list getters */
 
 n_GDrawCommandList * n_gdraw_command_image_get_command_list(n_GDrawCommandImage * image);
@@ -94,14 +94,17 @@ void n_graphics_font_draw_glyph_bounded(n_GContext * ctx, n_GGlyphInfo * glyph,
     n_GPoint p, int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
     p.x += glyph->left_offset;
     p.y += glyph->top_offset;
-    for (uint8_t y = 0; y < glyph->height; y++)
-        for (uint8_t x = 0; x < glyph->width; x++)
-            if (glyph->data[(y*glyph->width+x)/8] & (1 << ((y*glyph->width+x) % 8)) &&
-                    p.x + x >= minx && p.x + x < maxx &&
-                    p.y + y >= miny && p.y + y < maxy)
+    // clip the glyph once, so the pixel loop doesn't have to
+    int16_t x0 = __BOUND_NUM(0, minx - p.x, glyph->width),
+            x1 = __BOUND_NUM(0, maxx - p.x, glyph->width),
+            y0 = __BOUND_NUM(0, miny - p.y, glyph->height),
+            y1 = __BOUND_NUM(0, maxy - p.y, glyph->height);
+    for (int16_t y = y0; y < y1; y++)
+        for (int16_t x = x0; x < x1; x++)
+            if (glyph->data[(y*glyph->width+x)/8] & (1 << ((y*glyph->width+x) % 8)))
                 n_graphics_set_pixel(ctx, n_GPoint(p.x + x, p.y + y), ctx->text_color);
 }
 
 void n_graphics_font_draw_glyph(n_GContext * ctx, n_GGlyphInfo * glyph, n_GPoint p) {
-    n_graphics_font_draw_glyph_bounded(ctx, glyph, p, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+    n_graphics_font_draw_glyph_bounded(ctx, glyph, p, __CLIP_BOUNDS(ctx));
 }
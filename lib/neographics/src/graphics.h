@@ -40,6 +40,7 @@
 #include "path/path.h"
 
 #include "draw_command/draw_command.h"
+#include "deferred/deferred.h"
 
 #include "fonts/fonts.h"
 #include "text/text.h"
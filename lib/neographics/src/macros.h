@@ -50,3 +50,9 @@
     #define __SCREEN_WIDTH 180
     #define __SCREEN_HEIGHT 180
 #endif
+
+#ifdef PBL_ROUND
+    // Pixels at either end of row (or column) i that lie outside the
+    // round display. Provided by the platform.
+    #define __SCREEN_INSET(i) (display_row_inset[(i)])
+#endif
@@ -20,41 +20,82 @@
 \*/
 
 #include "path.h"
+#include "../deferred/deferred.h"
+
+// Paths from n_gpath_create keep their points as last drawn behind the
+// public struct. Apps may also build an n_GPath themselves, on the stack
+// say, with nothing behind it, so only paths on this list are cached.
+// The points live on the app heap and go with the app. The wrapper is on
+// the system heap like the n_GPath always was, so an app that never
+// destroys its paths still leaks those few bytes each, but
+// n_gpath_reset_cache forgets them at the next launch.
+typedef struct n_prv_CachedPath {
+    n_GPath path;
+    struct n_prv_CachedPath * next;
+    n_GPoint * transformed; // count transformed points, then their source
+    n_GPoint * source;
+    uint32_t count;
+    int32_t angle;
+    n_GPoint offset;
+} n_prv_CachedPath;
+
+static n_prv_CachedPath * n_prv_cached_paths;
+
+void n_gpath_reset_cache(void) {
+    n_prv_cached_paths = NULL;
+}
 
 n_GPath * n_gpath_create(n_GPathInfo * path_info) {
-    n_GPath * out = malloc(sizeof(n_GPath));
+    n_prv_CachedPath * cached = malloc(sizeof(n_prv_CachedPath));
+    if (!cached)
+        return NULL;
+    n_GPath * out = &cached->path;
     out->num_points = path_info->num_points;
     out->points = path_info->points;
     out->angle = 0;
     out->offset = n_GPointZero;
     out->open = false;
+    cached->transformed = NULL;
+    cached->count = 0;
+    cached->next = n_prv_cached_paths;
+    n_prv_cached_paths = cached;
     return out;
 }
 
 void n_gpath_destroy(n_GPath * path) {
+    for (n_prv_CachedPath ** link = &n_prv_cached_paths; *link; link = &(*link)->next) {
+        if (&(*link)->path == path) {
+            n_prv_CachedPath * cached = *link;
+            *link = cached->next;
+            if (cached->transformed)
+                app_free(cached->transformed);
+            break;
+        }
+    }
     free(path);
 }
 
 // --- //
 
-static void n_prv_bubblesort(int16_t * numbers, uint32_t amt) {
-    // Yes, bubblesort is sub-ideal. However, bubblesort is absolutely enough
-    // for 2-8 lines which will usually pass through a scanline.
-    if (!amt)
-        return;
-    bool swapped;
-    int16_t tmp;
-    do {
-        swapped = false;
-        for (uint32_t i = 0; i < amt-1; i++) {
-            if (numbers[i] > numbers[i+1]) {
-                tmp = numbers[i+1];
-                numbers[i+1] = numbers[i];
-                numbers[i] = tmp;
-                swapped = true;
-            }
-        }
-    } while(swapped);
+static n_GPoint n_prv_path_point(n_GPoint * points, uint32_t i, bool precise) {
+    if (precise)
+        return n_GPoint((points[i].x + 4) >> 3, (points[i].y + 4) >> 3);
+    return points[i];
+}
+
+// floor division, so the remainder stays in [0, den)
+static void n_prv_edge_divide(int32_t num, int32_t den, int16_t * q, int32_t * r) {
+    int32_t quot = num / den, rem = num % den;
+    if (rem < 0) {
+        quot -= 1;
+        rem += den;
+    }
+    *q = quot;
+    *r = rem;
+}
+
+static inline int16_t n_prv_edge_x(n_GPathEdge * edge) {
+    return edge->x0 + edge->q + (edge->r && edge->q < 0);
 }
 
 // --- //
@@ -77,161 +118,200 @@ void n_graphics_draw_ppath(n_GContext * ctx, uint32_t num_points, n_GPoint * poi
             n_GPoint((points[0].x + 4) >> 3, (points[0].y + 4) >> 3));
 }
 
-static void n_graphics_fill_path_bounded(n_GContext * ctx, uint32_t num_points, n_GPoint * points,
-                                         int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
-#ifdef PBL_BW
-    uint8_t color = __ARGB_TO_INTERNAL(ctx->fill_color.argb);
-#endif
+uint32_t n_graphics_prv_path_edges(uint32_t num_points, n_GPoint * points, bool precise,
+                                   n_GPathEdge * edges, int16_t * lowest) {
+    if (num_points < 2)
+        return 0;
+
+    // The bottom scanline is left to the outline, as the filled spans end
+    // above the path's lowest point.
+    *lowest = INT16_MIN;
+    for (uint32_t k = 0; k < num_points; k++) {
+        int16_t py = n_prv_path_point(points, k, precise).y;
+        if (py > *lowest) *lowest = py;
+    }
 
-    // Minimize size we iterate over
-    int16_t _maxy = miny, _miny = maxy;
-    for (uint32_t i = 0; i < num_points; i++) {
-        if (points[i].y < _miny) _miny = points[i].y;
-        if (points[i].y > _maxy) _maxy = points[i].y;
+    // Build the edge table. Edge i runs from point i to point i + 1 and
+    // covers the scanlines from its start up to (not including) its end,
+    // so every vertex is counted once. A vertex which is a local extremum
+    // is counted twice, which keeps the crossings paired up.
+    uint32_t num_edges = 0;
+    n_GPoint b = n_prv_path_point(points, num_points - 1, precise),
+             i = n_prv_path_point(points, 0, precise), n;
+    for (uint32_t k = 0; k < num_points; k++, b = i, i = n) {
+        n = n_prv_path_point(points, (k + 1) % num_points, precise);
+        if (i.y == n.y)
+            continue;
+
+        n_GPathEdge * edge = &edges[num_edges];
+        int16_t y0 = (i.y < n.y) ? i.y : n.y + 1,
+                y1 = (i.y < n.y) ? n.y - 1 : i.y;
+
+        // This is the same x as i.x + (dx * (y - i.y) * 2 + e * dy) / (dy * 2),
+        // rounded towards zero, just kept up incrementally instead.
+        int32_t dx = n.x - i.x, dy = n.y - i.y,
+                e = (dx == 0 ? 0 : (dx > 0 ? 1 : -1)),
+                sign = (dy > 0) ? 1 : -1;
+        edge->den = dy * 2 * sign;
+        n_prv_edge_divide(sign * (dx * (y0 - i.y) * 2 + e * dy), edge->den,
+                          &edge->q, &edge->r);
+        n_prv_edge_divide(sign * dx * 2, edge->den, &edge->dq, &edge->dr);
+        edge->x0 = i.x;
+        edge->y0 = y0;
+        edge->y1 = y1;
+        edge->ycorner = i.y;
+        edge->corner = (b.y < i.y && n.y < i.y) || (b.y > i.y && n.y > i.y);
+        num_edges++;
     }
-    maxy = __BOUND_NUM(miny, _maxy, maxy);
-    miny = __BOUND_NUM(miny, _miny, maxy);
-
-    // Further optimization may be possible here to minimize unnecessary allocation
-    int16_t * x_positions = malloc(sizeof(int16_t) * num_points);
-
-    for (int16_t y = miny; y <= maxy; y++) {
-        uint32_t num_x_positions = 0;
-        uint32_t b, i, n; // b, i, n == before, iter, next
-        for (i = 0; i < num_points; i++) {
-            b = (num_points + i - 1) % num_points;
-            n = (             i + 1) % num_points;
-
-            if ( (points[i].y <= y && points[n].y > y) ||
-                 (points[i].y >= y && points[n].y < y) ) {
-                bool rep = false;
-                int16_t dx = points[n].x - points[i].x,
-                        dy = points[n].y - points[i].y;
-                int8_t e = (dx == 0 ? 0 : (dx > 0 ? 1 : -1));
-
-                x_positions[num_x_positions] =
-                    points[i].x + (dx * (y - points[i].y) * 2 + e * dy) / (dy * 2);
-                num_x_positions += 1;
-
-                // If we're at a corner, add the position twice.
-                // We don't have to worry about going out of bounds of
-                // the array `x_positions` since being at a corner implies
-                // that at least one other point isn't in this scanline.
-                if ( (points[i].y == y &&
-                      points[b].y  < y && points[n].y < y) ||
-                     (points[i].y == y &&
-                      points[b].y  > y && points[n].y > y) ) {
-                    x_positions[num_x_positions] = x_positions[num_x_positions - 1];
-                    num_x_positions += 1;
-                }
-            }
-        }
-        n_prv_bubblesort(x_positions, num_x_positions);
-        for (uint32_t p = 0; (p + 1) < num_x_positions; p += 2) {
-            // We're not going to draw the path. Also, only actually draw if
-            // there is something to be drawn.
-            if (x_positions[p] <= x_positions[p+1] - 2)
-#ifdef PBL_BW
-                n_graphics_prv_draw_row(ctx->fbuf, y, x_positions[p] + 1, x_positions[p+1] - 1,
-                                        minx, maxx, miny, maxy, color);
-#else
-                n_graphics_prv_draw_row(ctx->fbuf, y, x_positions[p] + 1, x_positions[p+1] - 1,
-                                        minx, maxx, miny, maxy, ctx->fill_color.argb);
-#endif
-        }
+
+    // Sort by first scanline. The lists are short and mostly in order.
+    for (uint32_t k = 1; k < num_edges; k++) {
+        n_GPathEdge tmp = edges[k];
+        uint32_t j = k;
+        for (; j > 0 && edges[j - 1].y0 > tmp.y0; j--)
+            edges[j] = edges[j - 1];
+        edges[j] = tmp;
     }
-    free(x_positions);
+    return num_edges;
 }
 
-static void n_graphics_fill_ppath_bounded(n_GContext * ctx, uint32_t num_points, n_GPoint * _points,
-                                         int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
-    n_GPoint * points = malloc(sizeof(n_GPoint) * num_points);
-    for (uint32_t n = 0; n < num_points; n++) {
-        points[n] = n_GPoint((_points[n].x + 4) >> 3, (_points[n].y + 4) >> 3);
-    }
+void n_graphics_prv_fill_edges(n_GContext * ctx, n_GPathEdge * edges, uint32_t num_edges,
+                               int16_t lowest, n_GPoint offset,
+                               int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
 #ifdef PBL_BW
     uint8_t color = __ARGB_TO_INTERNAL(ctx->fill_color.argb);
+#else
+    uint8_t color = ctx->fill_color.argb;
 #endif
-
-    // Minimize size we iterate over
-    int16_t _maxy = miny, _miny = maxy;
-    for (uint32_t i = 0; i < num_points; i++) {
-        if (points[i].y < _miny) _miny = points[i].y;
-        if (points[i].y > _maxy) _maxy = points[i].y;
+    maxy = __BOUND_NUM(miny, lowest + offset.y, maxy);
+
+    // Move the edges into place and cut them to the clip. An edge starting
+    // above it is stepped down to miny, which keeps the order by y0.
+    uint32_t kept = 0;
+    for (uint32_t k = 0; k < num_edges; k++) {
+        n_GPathEdge edge = edges[k];
+        edge.x0 += offset.x;
+        edge.y0 += offset.y;
+        edge.y1 += offset.y;
+        edge.ycorner += offset.y;
+        if (edge.y1 >= maxy)
+            edge.y1 = maxy - 1;
+        if (edge.y0 < miny) {
+            int64_t steps = miny - edge.y0,
+                    r = edge.r + edge.dr * steps,
+                    q = edge.q + edge.dq * steps + r / edge.den;
+            edge.q = q;
+            edge.r = r % edge.den;
+            edge.y0 = miny;
+        }
+        if (edge.y0 > edge.y1)
+            continue;
+        edges[kept++] = edge;
     }
-    maxy = __BOUND_NUM(miny, _maxy, maxy);
-    miny = __BOUND_NUM(miny, _miny, maxy);
-
-    // Further optimization may be possible here to minimize unnecessary allocation
-    int16_t * x_positions = malloc(sizeof(int16_t) * num_points);
-
-    for (int16_t y = miny; y <= maxy; y++) {
-        uint32_t num_x_positions = 0;
-        uint32_t b, i, n; // b, i, n == before, iter, next
-        for (i = 0; i < num_points; i++) {
-            b = (num_points + i - 1) % num_points;
-            n = (             i + 1) % num_points;
-
-            if ( (points[i].y <= y && points[n].y > y) ||
-                 (points[i].y >= y && points[n].y < y) ) {
-                bool rep = false;
-                int16_t dx = points[n].x - points[i].x,
-                        dy = points[n].y - points[i].y;
-                int8_t e = (dx == 0 ? 0 : (dx > 0 ? 1 : -1));
-
-                x_positions[num_x_positions] =
-                    points[i].x + (dx * (y - points[i].y) * 2 + e * dy) / (dy * 2);
-                num_x_positions += 1;
-
-                // If we're at a corner, add the position twice.
-                // We don't have to worry about going out of bounds of
-                // the array `x_positions` since being at a corner implies
-                // that at least one other point isn't in this scanline.
-                if ( (points[i].y == y &&
-                      points[b].y  < y && points[n].y < y) ||
-                     (points[i].y == y &&
-                      points[b].y  > y && points[n].y > y) ) {
-                    x_positions[num_x_positions] = x_positions[num_x_positions - 1];
-                    num_x_positions += 1;
-                }
+    num_edges = kept;
+
+    // The active edges are edges[first_active .. next_edge), kept sorted by x
+    // by moving finished edges out to the front.
+    uint32_t first_active = 0, next_edge = 0;
+    int16_t y = num_edges ? edges[0].y0 : maxy;
+    for (; y < maxy && first_active < num_edges; y++) {
+        while (next_edge < num_edges && edges[next_edge].y0 == y)
+            next_edge++;
+
+        // Re-sort by the truncated x the spans use; edges only swap places
+        // where they cross, so this is close to linear.
+        for (uint32_t k = first_active + 1; k < next_edge; k++) {
+            n_GPathEdge tmp = edges[k];
+            int16_t tx = n_prv_edge_x(&tmp);
+            uint32_t j = k;
+            for (; j > first_active &&
+                   n_prv_edge_x(&edges[j - 1]) > tx; j--)
+                edges[j] = edges[j - 1];
+            edges[j] = tmp;
+        }
+
+        bool open = false;
+        int16_t from = 0;
+        for (uint32_t k = first_active; k < next_edge; k++) {
+            n_GPathEdge * edge = &edges[k];
+            int16_t x = n_prv_edge_x(edge);
+            for (uint8_t c = (edge->corner && edge->ycorner == y) ? 2 : 1; c; c--) {
+                // We're not going to draw the path. Also, only actually draw if
+                // there is something to be drawn.
+                if (open && from <= x - 2)
+                    n_graphics_prv_draw_row(ctx->fbuf, y, from + 1, x - 1,
+                                            minx, maxx, miny, maxy, color);
+                from = x;
+                open = !open;
+            }
+
+            edge->q += edge->dq;
+            edge->r += edge->dr;
+            if (edge->r >= edge->den) {
+                edge->r -= edge->den;
+                edge->q += 1;
             }
         }
-        n_prv_bubblesort(x_positions, num_x_positions);
-        for (uint32_t p = 0; (p + 1) < num_x_positions; p += 2) {
-            // We're not going to draw the path. Also, only actually draw if
-            // there is something to be drawn.
-            if (x_positions[p] <= x_positions[p+1] - 2)
-#ifdef PBL_BW
-                n_graphics_prv_draw_row(ctx->fbuf, y, x_positions[p] + 1, x_positions[p+1] - 1,
-                                        minx, maxx, miny, maxy, color);
-#else
-                n_graphics_prv_draw_row(ctx->fbuf, y, x_positions[p] + 1, x_positions[p+1] - 1,
-                                        minx, maxx, miny, maxy, ctx->fill_color.argb);
-#endif
+
+        for (uint32_t k = first_active; k < next_edge; k++) {
+            if (edges[k].y1 == y) {
+                n_GPathEdge tmp = edges[k];
+                for (uint32_t j = k; j > first_active; j--)
+                    edges[j] = edges[j - 1];
+                edges[first_active++] = tmp;
+            }
         }
+        // the next edge to start may be further down
+        if (first_active == next_edge && next_edge < num_edges)
+            y = edges[next_edge].y0 - 1;
+    }
+}
+
+static void n_graphics_fill_path_bounded(n_GContext * ctx, uint32_t num_points, n_GPoint * points,
+                                         bool precise, int16_t minx, int16_t maxx,
+                                         int16_t miny, int16_t maxy) {
+    n_GPathEdge stack_edges[N_GRAPHICS_PATH_STACK_EDGES];
+    n_GPathEdge * edges = stack_edges;
+    // Only unusually large paths need the heap.
+    if (num_points > N_GRAPHICS_PATH_STACK_EDGES) {
+        edges = malloc(sizeof(n_GPathEdge) * num_points);
+        if (!edges)
+            return;
     }
-    free(x_positions);
-    free(points);
+
+    int16_t lowest;
+    uint32_t num_edges = n_graphics_prv_path_edges(num_points, points, precise, edges, &lowest);
+    if (num_edges)
+        n_graphics_prv_fill_edges(ctx, edges, num_edges, lowest, n_GPointZero,
+                                  minx, maxx, miny, maxy);
+
+    if (edges != stack_edges)
+        free(edges);
 }
 
 void n_graphics_fill_path(n_GContext * ctx, uint32_t num_points, n_GPoint * points) {
-    n_graphics_fill_path_bounded(ctx, num_points, points, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+    // the points may not outlive the call, so fills aren't recorded
+    n_graphics_context_flush(ctx);
+    n_graphics_fill_path_bounded(ctx, num_points, points, false, __CLIP_BOUNDS(ctx));
 }
 
 void n_graphics_fill_ppath(n_GContext * ctx, uint32_t num_points, n_GPoint * points) {
-    n_graphics_fill_ppath_bounded(ctx, num_points, points, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+    n_graphics_context_flush(ctx);
+    n_graphics_fill_path_bounded(ctx, num_points, points, true, __CLIP_BOUNDS(ctx));
 }
 
 // --- //
 
 void n_prv_transform_points(uint32_t num_points, n_GPoint * points_in, n_GPoint * points_out,
                             int16_t angle, n_GPoint offset) {
+#ifndef NO_TRIG
+    int64_t sine   = sin_lookup(angle),
+            cosine = cos_lookup(angle);
+#endif
     for (uint32_t i = 0; i < num_points; i++) {
         points_out[i] = points_in[i];
 #ifndef NO_TRIG
         if (angle) {
-            int64_t sine   = sin_lookup(angle),
-                    cosine = cos_lookup(angle);
             points_out[i].x = (cosine * points_in[i].x -   sine * points_in[i].y) / TRIG_MAX_RATIO;
             points_out[i].y = (  sine * points_in[i].x + cosine * points_in[i].y) / TRIG_MAX_RATIO;
         }
@@ -241,25 +321,71 @@ void n_prv_transform_points(uint32_t num_points, n_GPoint * points_in, n_GPoint
     }
 }
 
+// The path's points rotated and moved into place. Hands are drawn at the
+// same angle for a minute or more, so a created path keeps the last result
+// and only works it out again once something changes. The source points
+// belong to the app and may be edited in place, so a hit still compares
+// them with a copy. Anything else gets a fresh copy, which *owned says to
+// free.
+static n_GPoint * n_prv_gpath_transformed(n_GPath * path, bool * owned) {
+    n_prv_CachedPath * cached = n_prv_cached_paths;
+    while (cached && &cached->path != path)
+        cached = cached->next;
+
+    *owned = !cached;
+    if (!cached) {
+        n_GPoint * points = malloc(sizeof(n_GPoint) * path->num_points);
+        if (points)
+            n_prv_transform_points(path->num_points, path->points, points,
+                                   path->angle, path->offset);
+        return points;
+    }
+
+    size_t size = sizeof(n_GPoint) * path->num_points;
+    if (cached->transformed && cached->count == path->num_points &&
+            cached->source == path->points && cached->angle == path->angle &&
+            cached->offset.x == path->offset.x && cached->offset.y == path->offset.y &&
+            !memcmp(cached->transformed + cached->count, path->points, size))
+        return cached->transformed;
+
+    if (cached->count != path->num_points) {
+        if (cached->transformed)
+            app_free(cached->transformed);
+        cached->transformed = app_malloc(size * 2);
+        cached->count = cached->transformed ? path->num_points : 0;
+        if (!cached->transformed)
+            return NULL;
+    }
+    n_prv_transform_points(path->num_points, path->points, cached->transformed,
+                           path->angle, path->offset);
+    memcpy(cached->transformed + cached->count, path->points, size);
+    cached->source = path->points;
+    cached->angle = path->angle;
+    cached->offset = path->offset;
+    return cached->transformed;
+}
+
 void n_gpath_draw(n_GContext * ctx, n_GPath * path) {
     if (!(ctx->stroke_color.argb & (0b11 << 6)))
         return;
-    n_GPoint * points = malloc(sizeof(n_GPoint) * path->num_points);
-    n_prv_transform_points(path->num_points, path->points, points,
-                           path->angle, path->offset);
-    n_graphics_draw_path(ctx, path->num_points, points, path->open);
-    free(points);
+    bool owned;
+    n_GPoint * points = n_prv_gpath_transformed(path, &owned);
+    if (points)
+        n_graphics_draw_path(ctx, path->num_points, points, path->open);
+    if (owned)
+        free(points);
 }
 
 void n_gpath_fill(n_GContext * ctx, n_GPath * path) {
     if (!(ctx->fill_color.argb & (0b11 << 6)))
         return;
     // n_gpath_fill_bounded(ctx, path, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
-    n_GPoint * points = malloc(sizeof(n_GPoint) * path->num_points);
-    n_prv_transform_points(path->num_points, path->points, points,
-        path->angle, path->offset);
-    n_graphics_fill_path(ctx, path->num_points, points);
-    free(points);
+    bool owned;
+    n_GPoint * points = n_prv_gpath_transformed(path, &owned);
+    if (points)
+        n_graphics_fill_path(ctx, path->num_points, points);
+    if (owned)
+        free(points);
 }
 
 // --- //
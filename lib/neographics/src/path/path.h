@@ -26,6 +26,20 @@
 
 #include "../primitives/line.h"
 
+// Paths with up to this many points are filled without touching the heap.
+// Kept small, the edges live on the caller's stack and app stacks are tight.
+#define N_GRAPHICS_PATH_STACK_EDGES 8
+
+// Edges of a filled path. An edge is live on the scanlines y0..y1, where it
+// crosses at x0 + q (rounded towards zero using the remainder r against den),
+// and steps q, r by dq, dr per line.
+typedef struct {
+    int16_t y0, y1, ycorner;
+    int16_t x0, q, dq;
+    int32_t r, dr, den;
+    bool corner;
+} n_GPathEdge;
+
 typedef struct {
     uint32_t num_points;
     n_GPoint * points;
@@ -41,6 +55,8 @@ typedef struct {
 
 n_GPath * n_gpath_create(n_GPathInfo * path_info);
 void n_gpath_destroy(n_GPath * path);
+// Forget the paths cached for the last app, before the next one starts.
+void n_gpath_reset_cache(void);
 
 void n_graphics_draw_path(n_GContext * ctx, uint32_t num_points, n_GPoint * points, bool open);
 void n_graphics_fill_path(n_GContext * ctx, uint32_t num_points, n_GPoint * points);
@@ -48,6 +64,19 @@ void n_graphics_fill_path(n_GContext * ctx, uint32_t num_points, n_GPoint * poin
 void n_graphics_draw_ppath(n_GContext * ctx, uint32_t num_points, n_GPoint * points, bool open);
 void n_graphics_fill_ppath(n_GContext * ctx, uint32_t num_points, n_GPoint * points);
 
+/*
+ * Builds the edge table of a filled path into edges (room for num_points)
+ * and returns how many there are. The table doesn't depend on the clip, so
+ * it can be kept and filled again with n_graphics_prv_fill_edges, which
+ * moves it by offset and steps through it in place. lowest is the path's
+ * bottom row, which the fill leaves to the outline.
+ */
+uint32_t n_graphics_prv_path_edges(uint32_t num_points, n_GPoint * points, bool precise,
+                                   n_GPathEdge * edges, int16_t * lowest);
+void n_graphics_prv_fill_edges(n_GContext * ctx, n_GPathEdge * edges, uint32_t num_edges,
+                               int16_t lowest, n_GPoint offset,
+                               int16_t minx, int16_t maxx, int16_t miny, int16_t maxy);
+
 void n_gpath_draw(n_GContext * ctx, n_GPath * path);
 void n_gpath_fill(n_GContext * ctx, n_GPath * path);
 
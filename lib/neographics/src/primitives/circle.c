@@ -20,25 +20,41 @@
 \*/
 
 #include "circle.h"
+#include "../deferred/deferred.h"
 
-void n_graphics_fill_circle_bounded(n_GContext * ctx, n_GPoint p, uint16_t radius,
-        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
+/*\
+|*| Circle span cache
+|*|
+|*| Filled circles and thick rings are drawn from tables of half-widths, one
+|*| per row from the center outwards. Watchfaces draw the same few radii
+|*| every frame, so the last few tables are kept around; rounded rect
+|*| corners and arcs are drawn from the same tables. Entries are keyed by
+|*| radius and stroke width, with width 0 for filled circles. Only the
+|*| render thread draws, so there is no locking.
+\*/
+
+static n_GCircleSpans n_prv_circle_cache[N_GRAPHICS_CIRCLE_CACHE_ENTRIES];
+static uint8_t n_prv_circle_cache_next;
+static uint32_t n_prv_circle_cache_hits, n_prv_circle_cache_misses;
+
+// The half-widths the midpoint fill below draws, row by row. A row can be
+// reached from both octants, so keep the widest.
+static void n_prv_circle_fill_widths(uint16_t radius, uint8_t * half) {
     int32_t err = 1 - radius,
             err_a = -radius * 2,
             err_b = 0;
     uint16_t a = radius,
              b = 0;
-#ifdef PBL_BW
-    uint8_t bytefill = __ARGB_TO_INTERNAL(ctx->fill_color.argb);
-#else
-    uint8_t bytefill = ctx->fill_color.argb;
-#endif
+    memset(half, 0, radius + 1);
+    // a single pixel; the loop below would wrap a around
+    if (radius == 0)
+        return;
     while (b <= a) {
-        n_graphics_prv_draw_row(ctx->fbuf, p.y - b, p.x - a, p.x + a, minx, maxx, miny, maxy, bytefill);
-        n_graphics_prv_draw_row(ctx->fbuf, p.y + b, p.x - a, p.x + a, minx, maxx, miny, maxy, bytefill);
+        if (half[b] < a)
+            half[b] = a;
         if (err >= 0) {
-            n_graphics_prv_draw_row(ctx->fbuf, p.y - a, p.x - b, p.x + b, minx, maxx, miny, maxy, bytefill);
-            n_graphics_prv_draw_row(ctx->fbuf, p.y + a, p.x - b, p.x + b, minx, maxx, miny, maxy, bytefill);
+            if (half[a] < b)
+                half[a] = b;
             b += 1;
             a -= 1;
             err_a += 2;
@@ -52,40 +68,116 @@ void n_graphics_fill_circle_bounded(n_GContext * ctx, n_GPoint p, uint16_t radiu
     }
 }
 
-void n_graphics_draw_circle_1px_bounded(n_GContext * ctx, n_GPoint p, uint16_t radius, int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
+const n_GCircleSpans * n_graphics_prv_circle_spans(uint16_t radius, uint16_t width) {
+    // rings are what's left of the outer circle once the inner one is taken out
+    uint16_t line_radius = width ? (width - 1) / 2 : 0,
+             outer = radius + line_radius;
+    if (outer > N_GRAPHICS_CIRCLE_CACHE_MAX_RADIUS)
+        return NULL;
+
+    for (uint8_t i = 0; i < N_GRAPHICS_CIRCLE_CACHE_ENTRIES; i++) {
+        n_GCircleSpans * entry = &n_prv_circle_cache[i];
+        if (entry->valid && entry->radius == radius && entry->width == width) {
+            n_prv_circle_cache_hits++;
+            return entry;
+        }
+    }
+    n_prv_circle_cache_misses++;
+
+    n_GCircleSpans * entry = &n_prv_circle_cache[n_prv_circle_cache_next];
+    n_prv_circle_cache_next = (n_prv_circle_cache_next + 1) % N_GRAPHICS_CIRCLE_CACHE_ENTRIES;
+    entry->radius = radius;
+    entry->width = width;
+    entry->rows = outer + 1;
+    n_prv_circle_fill_widths(outer, entry->outer);
+    memset(entry->hole, 0, entry->rows);
+    if (width && radius > line_radius) {
+        uint16_t inner = radius - line_radius - 1;
+        n_prv_circle_fill_widths(inner, entry->hole);
+        for (uint16_t dy = 0; dy <= inner; dy++)
+            entry->hole[dy] += 1;
+    }
+    entry->valid = true;
+    return entry;
+}
+
+void n_graphics_circle_cache_get_stats(uint32_t * hits, uint32_t * misses) {
+    *hits = n_prv_circle_cache_hits;
+    *misses = n_prv_circle_cache_misses;
+}
+
+void n_graphics_circle_cache_reset_stats(void) {
+    n_prv_circle_cache_hits = 0;
+    n_prv_circle_cache_misses = 0;
+}
+
+static void n_prv_draw_circle_row(uint8_t * fb, int16_t x, int16_t y,
+        int16_t outer, int16_t hole,
+        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy, uint8_t color) {
+    if (hole) {
+        n_graphics_prv_draw_row(fb, y, x - outer, x - hole, minx, maxx, miny, maxy, color);
+        n_graphics_prv_draw_row(fb, y, x + hole, x + outer, minx, maxx, miny, maxy, color);
+    } else {
+        n_graphics_prv_draw_row(fb, y, x - outer, x + outer, minx, maxx, miny, maxy, color);
+    }
+}
+
+static void n_prv_draw_circle_spans(uint8_t * fb, n_GPoint p, const n_GCircleSpans * spans,
+        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy, uint8_t color) {
+    // only the rows inside the clip, a deferred flush replays per band
+    int16_t top = p.y - spans->rows + 1,
+            bottom = p.y + spans->rows - 1;
+    if (top < miny)
+        top = miny;
+    if (bottom > maxy - 1)
+        bottom = maxy - 1;
+    for (int16_t y = top; y <= bottom; y++) {
+        uint16_t dy = y < p.y ? p.y - y : y - p.y;
+        if (spans->width == 0) // filled, no holes to skip
+            n_graphics_prv_draw_row(fb, y, p.x - spans->outer[dy], p.x + spans->outer[dy],
+                                    minx, maxx, miny, maxy, color);
+        else
+            n_prv_draw_circle_row(fb, p.x, y, spans->outer[dy], spans->hole[dy],
+                                  minx, maxx, miny, maxy, color);
+    }
+}
+
+void n_graphics_fill_circle_bounded(n_GContext * ctx, n_GPoint p, uint16_t radius,
+        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
+#ifdef PBL_BW
+    uint8_t color = __ARGB_TO_INTERNAL(ctx->fill_color.argb);
+#else
+    uint8_t color = ctx->fill_color.argb;
+#endif
+    const n_GCircleSpans * spans = n_graphics_prv_circle_spans(radius, 0);
+    if (spans) {
+        n_prv_draw_circle_spans(ctx->fbuf, p, spans, minx, maxx, miny, maxy, color);
+        return;
+    }
+
+    // too big to cache; the same spans, worked out for this draw
+    if (radius <= N_GRAPHICS_ARC_MAX_RADIUS) {
+        n_graphics_prv_fill_arc_bounded(ctx, p, radius, 0, 0, TRIG_MAX_ANGLE, color,
+                                        minx, maxx, miny, maxy);
+        return;
+    }
+    int32_t err = 1 - radius,
+            err_a = -radius * 2,
+            err_b = 0;
     uint16_t a = radius,
              b = 0;
-    int16_t err = 1 - a,
-             err_a = -a * 2,
-             err_b = 1;
+    uint8_t bytefill = color;
     while (b <= a) {
-        if (p.x + a >= minx && p.x + a < maxx) {
-            if (p.y + b >= miny && p.y + b < maxy)
-                n_graphics_draw_pixel(ctx, n_GPoint(p.x + a, p.y + b));
-            if (p.y - b >= miny && p.y - b < maxy)
-                n_graphics_draw_pixel(ctx, n_GPoint(p.x + a, p.y - b));
-        }
-        if (p.x - a >= minx && p.x - a < maxx) {
-            if (p.y + b >= miny && p.y + b < maxy)
-                n_graphics_draw_pixel(ctx, n_GPoint(p.x - a, p.y + b));
-            if (p.y - b >= miny && p.y - b < maxy)
-                n_graphics_draw_pixel(ctx, n_GPoint(p.x - a, p.y - b));
-        }
-        if (p.x + b >= minx && p.x + b < maxx) {
-            if (p.y + a >= miny && p.y + a < maxy)
-                n_graphics_draw_pixel(ctx, n_GPoint(p.x + b, p.y + a));
-            if (p.y - a >= miny && p.y - a < maxy)
-                n_graphics_draw_pixel(ctx, n_GPoint(p.x + b, p.y - a));
-        }
-        if (p.x - b >= minx && p.x - b < maxx) {
-            if (p.y + a >= miny && p.y + a < maxy)
-                n_graphics_draw_pixel(ctx, n_GPoint(p.x - b, p.y + a));
-            if (p.y - a >= miny && p.y - a < maxy)
-                n_graphics_draw_pixel(ctx, n_GPoint(p.x - b, p.y - a));
+        n_graphics_prv_draw_row(ctx->fbuf, p.y - b, p.x - a, p.x + a, minx, maxx, miny, maxy, bytefill);
+        if (b != 0)
+            n_graphics_prv_draw_row(ctx->fbuf, p.y + b, p.x - a, p.x + a, minx, maxx, miny, maxy, bytefill);
+        if (err >= 0 && a != b) {
+            n_graphics_prv_draw_row(ctx->fbuf, p.y - a, p.x - b, p.x + b, minx, maxx, miny, maxy, bytefill);
+            n_graphics_prv_draw_row(ctx->fbuf, p.y + a, p.x - b, p.x + b, minx, maxx, miny, maxy, bytefill);
         }
         if (err >= 0) {
-            a -= 1;
             b += 1;
+            a -= 1;
             err_a += 2;
             err_b += 2;
             err += err_a + err_b;
@@ -97,107 +189,41 @@ void n_graphics_draw_circle_1px_bounded(n_GContext * ctx, n_GPoint p, uint16_t r
     }
 }
 
-void n_graphics_prv_draw_quarter_circle_bounded(n_GContext * ctx, n_GPoint p,
-        uint16_t radius, uint16_t width, int8_t x_dir, int8_t y_dir,
+static void n_prv_draw_octant_pixel(n_GContext * ctx, int16_t x, int16_t y,
         int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
-    uint16_t line_radius = (width - 1) / 2;
-    uint16_t a1 = __BOUND_NUM(0, radius - line_radius, radius),
-             b1 = 0,
-             a2 = radius + line_radius,
-             b2 = 0;
-    int16_t err1 = 1 - a1,
-            err_a1 = -a1 * 2,
-            err_b1 = 1,
-            // ---
-            err2 = 1 - a2,
-            err_a2 = -a2 * 2,
-            err_b2 = 1;
-#ifdef PBL_BW
-    uint8_t color = __ARGB_TO_INTERNAL(ctx->stroke_color.argb);
-#else
-    uint8_t color = ctx->stroke_color.argb;
-#endif
-    if (y_dir == 1)
-        n_graphics_prv_draw_col(ctx->fbuf, p.x + b2 * x_dir, p.y + a1, p.y + a2,
-                                minx, maxx, miny, maxy, color);
-    else
-        n_graphics_prv_draw_col(ctx->fbuf, p.x + b2 * x_dir, p.y - a2, p.y - a1,
-                                minx, maxx, miny, maxy, color);
-    if (x_dir == 1)
-        n_graphics_prv_draw_row(ctx->fbuf, p.y + b2 * y_dir, p.x + a1, p.x + a2,
-                                minx, maxx, miny, maxy, color);
-    else
-        n_graphics_prv_draw_row(ctx->fbuf, p.y + b2 * y_dir, p.x - a2, p.x - a1,
-                                minx, maxx, miny, maxy, color);
-    while ((b1 <= a1 && a1 != 0) || b2 <= a2) {
-        if (b2 <= a2 && a2 != 0) {
-            if (err2 >= 0) {
-                b2 += 1;
-                a2 -= 1;
-                err_a2 += 2;
-                err_b2 += 2;
-                err2 += err_a2 + err_b2;
-            } else {
-                b2 += 1;
-                err_b2 += 2;
-                err2 += err_b2 + 1;
-            }
-        }
-        if (b1 <= a1 && a1 != 0) {
-            if (err1 >= 0) {
-                a1 -= 1;
-                b1 += 1;
-                err_a1 += 2;
-                err_b1 += 2;
-                err1 += err_a1 + err_b1;
-            } else {
-                b1 += 1;
-                err_b1 += 2;
-                err1 += err_b1 + 1;
-            }
-        }
-        // TODO possible optimization by not rendering so far
-        if (y_dir == 1)
-            n_graphics_prv_draw_col(ctx->fbuf, p.x + b2 * x_dir, p.y + a1, p.y + a2,
-                                    minx, maxx, miny, maxy, color);
-        else
-            n_graphics_prv_draw_col(ctx->fbuf, p.x + b2 * x_dir, p.y - a2, p.y - a1,
-                                    minx, maxx, miny, maxy, color);
-        if (x_dir == 1)
-            n_graphics_prv_draw_row(ctx->fbuf, p.y + b2 * y_dir, p.x + a1, p.x + a2,
-                                    minx, maxx, miny, maxy, color);
-        else
-            n_graphics_prv_draw_row(ctx->fbuf, p.y + b2 * y_dir, p.x - a2, p.x - a1,
-                                    minx, maxx, miny, maxy, color);
-    }
+    if (x >= minx && x < maxx && y >= miny && y < maxy)
+        n_graphics_draw_pixel(ctx, n_GPoint(x, y));
 }
 
-void n_graphics_prv_fill_quarter_circle_bounded(n_GContext * ctx, n_GPoint p,
-        uint16_t radius, int8_t x_dir, int8_t y_dir,
+// Draws (a, b) mirrored into all eight octants around p, hitting the pixels
+// on the axes and diagonals only once so translucent strokes stay even.
+static void n_prv_draw_octants(n_GContext * ctx, n_GPoint p, int16_t a, int16_t b,
         int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
-    int32_t err = 1 - radius,
-            err_a = -radius * 2,
-            err_b = 0;
+    n_prv_draw_octant_pixel(ctx, p.x + a, p.y + b, minx, maxx, miny, maxy);
+    n_prv_draw_octant_pixel(ctx, p.x - a, p.y - b, minx, maxx, miny, maxy);
+    if (b != 0) {
+        n_prv_draw_octant_pixel(ctx, p.x + a, p.y - b, minx, maxx, miny, maxy);
+        n_prv_draw_octant_pixel(ctx, p.x - a, p.y + b, minx, maxx, miny, maxy);
+    }
+    if (a == b)
+        return;
+    n_prv_draw_octant_pixel(ctx, p.x + b, p.y + a, minx, maxx, miny, maxy);
+    n_prv_draw_octant_pixel(ctx, p.x - b, p.y - a, minx, maxx, miny, maxy);
+    if (b != 0) {
+        n_prv_draw_octant_pixel(ctx, p.x - b, p.y + a, minx, maxx, miny, maxy);
+        n_prv_draw_octant_pixel(ctx, p.x + b, p.y - a, minx, maxx, miny, maxy);
+    }
+}
+
+void n_graphics_draw_circle_1px_bounded(n_GContext * ctx, n_GPoint p, uint16_t radius, int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
     uint16_t a = radius,
              b = 0;
-#ifdef PBL_BW
-    uint8_t bytefill = __ARGB_TO_INTERNAL(ctx->fill_color.argb);
-#else
-    uint8_t bytefill = ctx->fill_color.argb;
-#endif
+    int16_t err = 1 - a,
+             err_a = -a * 2,
+             err_b = 1;
     while (b <= a) {
-        if (x_dir == 1) {
-            n_graphics_prv_draw_row(ctx->fbuf, p.y + b * y_dir, p.x, p.x + a, minx, maxx, miny, maxy, bytefill);
-        } else {
-            n_graphics_prv_draw_row(ctx->fbuf, p.y + b * y_dir, p.x - a, p.x, minx, maxx, miny, maxy, bytefill);
-        }
-
+        n_prv_draw_octants(ctx, p, a, b, minx, maxx, miny, maxy);
         if (err >= 0) {
-            if (x_dir == 1) {
-                n_graphics_prv_draw_row(ctx->fbuf, p.y + a * y_dir, p.x, p.x + b, minx, maxx, miny, maxy, bytefill);
-            } else {
-                n_graphics_prv_draw_row(ctx->fbuf, p.y + a * y_dir, p.x - b, p.x, minx, maxx, miny, maxy, bytefill);
-            }
             a -= 1;
             b += 1;
             err_a += 2;
@@ -211,8 +237,73 @@ void n_graphics_prv_fill_quarter_circle_bounded(n_GContext * ctx, n_GPoint p,
     }
 }
 
+#ifndef PBL_BW
+// Blends the points (a, b) mirrored into all eight octants around p,
+// without hitting the pixels on the axes and diagonals twice.
+static void prv_blend_octants(n_GContext * ctx, n_GPoint p, int16_t a, int16_t b,
+        uint8_t coverage, int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
+    uint8_t color = ctx->stroke_color.argb;
+    n_graphics_prv_blend_pixel(ctx->fbuf, p.x + a, p.y + b, minx, maxx, miny, maxy, color, coverage);
+    n_graphics_prv_blend_pixel(ctx->fbuf, p.x - a, p.y - b, minx, maxx, miny, maxy, color, coverage);
+    if (b != 0) {
+        n_graphics_prv_blend_pixel(ctx->fbuf, p.x + a, p.y - b, minx, maxx, miny, maxy, color, coverage);
+        n_graphics_prv_blend_pixel(ctx->fbuf, p.x - a, p.y + b, minx, maxx, miny, maxy, color, coverage);
+    }
+    if (a == b)
+        return;
+    n_graphics_prv_blend_pixel(ctx->fbuf, p.x + b, p.y + a, minx, maxx, miny, maxy, color, coverage);
+    n_graphics_prv_blend_pixel(ctx->fbuf, p.x - b, p.y - a, minx, maxx, miny, maxy, color, coverage);
+    if (b != 0) {
+        n_graphics_prv_blend_pixel(ctx->fbuf, p.x - b, p.y + a, minx, maxx, miny, maxy, color, coverage);
+        n_graphics_prv_blend_pixel(ctx->fbuf, p.x + b, p.y - a, minx, maxx, miny, maxy, color, coverage);
+    }
+}
+
+// Wu's circle: for each step along the octant, the exact radius falls
+// between two pixels which split the coverage.
+void n_graphics_draw_circle_1px_aa_bounded(n_GContext * ctx, n_GPoint p, uint16_t radius,
+        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
+    uint32_t r2 = (uint32_t) radius * radius;
+    for (uint16_t b = 0; b <= radius; b++) {
+        // a with 8 fractional bits
+        uint32_t a_fp = n_graphics_prv_int_sqrt((r2 - (uint32_t) b * b) << 16);
+        int16_t a = a_fp >> 8;
+        uint8_t frac = a_fp & 0xFF;
+        if (a < b)
+            break;
+        prv_blend_octants(ctx, p, a, b, 255 - frac, minx, maxx, miny, maxy);
+        if (frac)
+            prv_blend_octants(ctx, p, a + 1, b, frac, minx, maxx, miny, maxy);
+    }
+}
+#endif
+
 void n_graphics_draw_thick_circle_bounded(n_GContext * ctx, n_GPoint p, uint16_t radius, uint16_t width, int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
+    const n_GCircleSpans * spans = n_graphics_prv_circle_spans(radius, width);
+    if (spans) {
+#ifdef PBL_BW
+        n_prv_draw_circle_spans(ctx->fbuf, p, spans, minx, maxx, miny, maxy,
+                                __ARGB_TO_INTERNAL(ctx->stroke_color.argb));
+#else
+        n_prv_draw_circle_spans(ctx->fbuf, p, spans, minx, maxx, miny, maxy,
+                                ctx->stroke_color.argb);
+#endif
+        return;
+    }
+
+    // too big to cache; the same ring, worked out for this draw
     uint16_t line_radius = (width - 1) / 2;
+    if (radius + line_radius <= N_GRAPHICS_ARC_MAX_RADIUS) {
+#ifdef PBL_BW
+        uint8_t ring_color = __ARGB_TO_INTERNAL(ctx->stroke_color.argb);
+#else
+        uint8_t ring_color = ctx->stroke_color.argb;
+#endif
+        n_graphics_prv_fill_arc_bounded(ctx, p, radius + line_radius,
+                                        radius > line_radius ? radius - line_radius : 0,
+                                        0, TRIG_MAX_ANGLE, ring_color, minx, maxx, miny, maxy);
+        return;
+    }
     uint16_t a1 = __BOUND_NUM(0, radius - line_radius, radius),
              b1 = 0,
              a2 = radius + line_radius,
@@ -298,15 +389,210 @@ void n_graphics_draw_thick_circle_bounded(n_GContext * ctx, n_GPoint p, uint16_t
 void n_graphics_draw_circle(n_GContext * ctx, n_GPoint p, uint16_t radius) {
     if (radius == 0 || !(ctx->stroke_color.argb & (0b11 << 6)))
         return;
+    if (ctx->deferred) {
+        n_graphics_prv_defer_circle(ctx, n_GDeferredOpDrawCircle, p, radius);
+        return;
+    }
+#ifndef PBL_BW
+    // the coverage maths runs out of bits past N_GRAPHICS_AA_MAX_RADIUS
+    if (ctx->stroke_width == 1 && ctx->antialias && radius <= N_GRAPHICS_AA_MAX_RADIUS) {
+        n_graphics_draw_circle_1px_aa_bounded(ctx, p, radius, __CLIP_BOUNDS(ctx));
+        return;
+    }
+#endif
     if (ctx->stroke_width == 1) {
-        n_graphics_draw_circle_1px_bounded(ctx, p, radius, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+        n_graphics_draw_circle_1px_bounded(ctx, p, radius, __CLIP_BOUNDS(ctx));
     } else {
         // naive approach; testing for speed
-        n_graphics_draw_thick_circle_bounded(ctx, p, radius, ctx->stroke_width, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+        n_graphics_draw_thick_circle_bounded(ctx, p, radius, ctx->stroke_width, __CLIP_BOUNDS(ctx));
     }
 }
 
 void n_graphics_fill_circle(n_GContext * ctx, n_GPoint p, uint16_t radius) {
-    if (ctx->fill_color.argb & (0b11 << 6))
-        n_graphics_fill_circle_bounded(ctx, p, radius, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+    if (!(ctx->fill_color.argb & (0b11 << 6)))
+        ;
+    else if (ctx->deferred)
+        n_graphics_prv_defer_circle(ctx, n_GDeferredOpFillCircle, p, radius);
+    else
+        n_graphics_fill_circle_bounded(ctx, p, radius, __CLIP_BOUNDS(ctx));
+}
+
+/*\
+|*| Arcs
+|*|
+|*| An arc is a ring with a wedge cut out of each row. Both edges of the
+|*| wedge are lines through the center, so on any one row each keeps dx on
+|*| one side of a single point, found with one division. Wedges up to half
+|*| a turn are what both edges keep, wider ones what either keeps, so a row
+|*| never has more than four spans and an arc costs about what its circle
+|*| does.
+\*/
+
+typedef struct {
+    // edge directions, (sin, -cos) of the start and end angles
+    int32_t sx, sy, ex, ey;
+    bool wide;
+    bool full;
+} n_prv_ArcWedge;
+
+// floor(num / den), den > 0
+static int32_t n_prv_arc_divide(int32_t num, int32_t den) {
+    int32_t q = num / den;
+    return (num % den < 0) ? q - 1 : q;
+}
+
+// The dx that satisfy a * dx <= b, clamped to -limit .. limit. Empty when
+// lo > hi.
+static void n_prv_arc_half_line(int32_t a, int32_t b, int16_t limit, int16_t * lo, int16_t * hi) {
+    *lo = -limit;
+    *hi = limit;
+    if (a > 0)
+        *hi = __BOUND_NUM(-limit - 1, n_prv_arc_divide(b, a), limit);
+    else if (a < 0)
+        *lo = __BOUND_NUM(-limit, -n_prv_arc_divide(b, -a), limit + 1);
+    else if (b < 0)
+        *lo = limit + 1;
+}
+
+static void n_prv_arc_span(uint8_t * fb, n_GPoint p, int16_t dy, int16_t left, int16_t right,
+        const int16_t * keep, uint8_t keep_count,
+        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy, uint8_t color) {
+    for (uint8_t i = 0; i < keep_count; i++)
+        n_graphics_prv_draw_row(fb, p.y + dy,
+                                p.x + (left > keep[2 * i] ? left : keep[2 * i]),
+                                p.x + (right < keep[2 * i + 1] ? right : keep[2 * i + 1]),
+                                minx, maxx, miny, maxy, color);
+}
+
+static void n_prv_arc_row(uint8_t * fb, n_GPoint p, int16_t dy, int16_t outer, int16_t hole,
+        const n_prv_ArcWedge * wedge,
+        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy, uint8_t color) {
+    // up to two runs of dx inside the wedge, as lo, hi pairs
+    int16_t keep[4] = { -outer, outer };
+    uint8_t keep_count = 1;
+    if (!wedge->full) {
+        // clockwise of the start edge, and anticlockwise of the end edge
+        n_prv_arc_half_line(wedge->sy, wedge->sx * dy, outer, &keep[0], &keep[1]);
+        n_prv_arc_half_line(-wedge->ey, -wedge->ex * dy, outer, &keep[2], &keep[3]);
+        if (!wedge->wide) {
+            keep[0] = keep[0] > keep[2] ? keep[0] : keep[2];
+            keep[1] = keep[1] < keep[3] ? keep[1] : keep[3];
+        } else if (keep[2] <= keep[1] + 1 && keep[0] <= keep[3] + 1) {
+            // they touch; one span, so nothing is drawn twice
+            keep[0] = keep[0] < keep[2] ? keep[0] : keep[2];
+            keep[1] = keep[1] > keep[3] ? keep[1] : keep[3];
+        } else {
+            keep_count = 2;
+        }
+    }
+    if (hole) {
+        n_prv_arc_span(fb, p, dy, -outer, -hole, keep, keep_count, minx, maxx, miny, maxy, color);
+        n_prv_arc_span(fb, p, dy, hole, outer, keep, keep_count, minx, maxx, miny, maxy, color);
+    } else {
+        n_prv_arc_span(fb, p, dy, -outer, outer, keep, keep_count, minx, maxx, miny, maxy, color);
+    }
+}
+
+void n_graphics_prv_fill_arc_bounded(n_GContext * ctx, n_GPoint p, uint16_t outer, uint16_t inner,
+        int32_t angle_start, int32_t angle_end, uint8_t color,
+        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy) {
+    if (angle_end <= angle_start || outer > N_GRAPHICS_ARC_MAX_RADIUS)
+        return;
+
+    n_prv_ArcWedge wedge = {
+        .sx = sin_lookup(angle_start),
+        .sy = -cos_lookup(angle_start),
+        .ex = sin_lookup(angle_end),
+        .ey = -cos_lookup(angle_end),
+        .wide = angle_end - angle_start > TRIG_MAX_ANGLE / 2,
+        .full = angle_end - angle_start >= TRIG_MAX_ANGLE,
+    };
+
+    // the ring covers fill(outer) less fill(inner - 1), like the cached rings
+    uint8_t stack_widths[2 * (N_GRAPHICS_CIRCLE_CACHE_MAX_RADIUS + 1)];
+    uint8_t * widths = stack_widths;
+    if (outer > N_GRAPHICS_CIRCLE_CACHE_MAX_RADIUS) {
+        widths = malloc(2 * (outer + 1));
+        if (!widths)
+            return;
+        n_prv_circle_fill_widths(outer, widths);
+        memset(widths + outer + 1, 0, outer + 1);
+        if (inner > 0)
+            n_prv_circle_fill_widths(inner - 1, widths + outer + 1);
+    } else {
+        // copied out, the second lookup may evict the first
+        memcpy(widths, n_graphics_prv_circle_spans(outer, 0)->outer, outer + 1);
+        memset(widths + outer + 1, 0, outer + 1);
+        if (inner > 0)
+            memcpy(widths + outer + 1, n_graphics_prv_circle_spans(inner - 1, 0)->outer, inner);
+    }
+    uint8_t * holes = widths + outer + 1;
+    for (uint16_t dy = 0; dy < inner; dy++)
+        holes[dy] += 1;
+
+    int16_t top = p.y - outer > miny ? p.y - outer : miny,
+            bottom = p.y + outer < maxy - 1 ? p.y + outer : maxy - 1;
+    for (int16_t y = top; y <= bottom; y++) {
+        uint16_t dy = y < p.y ? p.y - y : y - p.y;
+        n_prv_arc_row(ctx->fbuf, p, y - p.y, widths[dy], holes[dy], &wedge,
+                      minx, maxx, miny, maxy, color);
+    }
+
+    if (widths != stack_widths)
+        free(widths);
+}
+
+// The center and radius of the circle scale_mode puts in rect.
+static uint16_t n_prv_oval_circle(n_GRect rect, n_GOvalScaleMode scale_mode, n_GPoint * p) {
+    int16_t w = rect.size.w, h = rect.size.h;
+    int16_t side = (scale_mode == n_GOvalScaleModeFillCircle) ? (w > h ? w : h)
+                                                              : (w < h ? w : h);
+    p->x = rect.origin.x + (w - 1) / 2;
+    p->y = rect.origin.y + (h - 1) / 2;
+    return side > 0 ? (side - 1) / 2 : 0;
+}
+
+void n_graphics_draw_arc(n_GContext * ctx, n_GRect rect, n_GOvalScaleMode scale_mode,
+        int32_t angle_start, int32_t angle_end) {
+    if (rect.size.w <= 0 || rect.size.h <= 0 || !(ctx->stroke_color.argb & (0b11 << 6)))
+        return;
+    if (ctx->deferred) {
+        n_graphics_prv_defer_arc(ctx, n_GDeferredOpDrawArc, rect, scale_mode, 0,
+                                 angle_start, angle_end);
+        return;
+    }
+    n_GPoint p;
+    uint16_t radius = n_prv_oval_circle(rect, scale_mode, &p),
+             line_radius = (ctx->stroke_width - 1) / 2;
+#ifdef PBL_BW
+    uint8_t color = __ARGB_TO_INTERNAL(ctx->stroke_color.argb);
+#else
+    uint8_t color = ctx->stroke_color.argb;
+#endif
+    // centered on the circle, like a thick n_graphics_draw_circle
+    n_graphics_prv_fill_arc_bounded(ctx, p, radius + line_radius,
+                                    radius > line_radius ? radius - line_radius : 0,
+                                    angle_start, angle_end, color, __CLIP_BOUNDS(ctx));
+}
+
+void n_graphics_fill_radial(n_GContext * ctx, n_GRect rect, n_GOvalScaleMode scale_mode,
+        uint16_t inset_thickness, int32_t angle_start, int32_t angle_end) {
+    if (rect.size.w <= 0 || rect.size.h <= 0 || inset_thickness == 0 ||
+            !(ctx->fill_color.argb & (0b11 << 6)))
+        return;
+    if (ctx->deferred) {
+        n_graphics_prv_defer_arc(ctx, n_GDeferredOpFillRadial, rect, scale_mode,
+                                 inset_thickness, angle_start, angle_end);
+        return;
+    }
+    n_GPoint p;
+    uint16_t radius = n_prv_oval_circle(rect, scale_mode, &p);
+#ifdef PBL_BW
+    uint8_t color = __ARGB_TO_INTERNAL(ctx->fill_color.argb);
+#else
+    uint8_t color = ctx->fill_color.argb;
+#endif
+    n_graphics_prv_fill_arc_bounded(ctx, p, radius,
+                                    inset_thickness <= radius ? radius - inset_thickness + 1 : 0,
+                                    angle_start, angle_end, color, __CLIP_BOUNDS(ctx));
 }
@@ -24,15 +24,60 @@
 #include "../common.h"
 #include "line.h"
 
+// How many circle span tables are kept, and the largest (outer) radius kept.
+#define N_GRAPHICS_CIRCLE_CACHE_ENTRIES 4
+#define N_GRAPHICS_CIRCLE_CACHE_MAX_RADIUS 90
+
+/*!
+ * Half-widths of a filled circle (width 0) or a ring of the given stroke
+ * width. Row p.y +/- dy covers p.x - outer[dy] .. p.x + outer[dy], less
+ * p.x - hole[dy] + 1 .. p.x + hole[dy] - 1 where hole[dy] is non-zero.
+ */
+typedef struct {
+    bool valid;
+    uint16_t radius;
+    uint16_t width;
+    uint16_t rows;
+    uint8_t outer[N_GRAPHICS_CIRCLE_CACHE_MAX_RADIUS + 1];
+    uint8_t hole[N_GRAPHICS_CIRCLE_CACHE_MAX_RADIUS + 1];
+} n_GCircleSpans;
+
+/*!
+ * Looks up (or works out and caches) the spans for a circle. Returns NULL
+ * when the circle is too big for the cache. The result is only good until
+ * the next lookup.
+ */
+const n_GCircleSpans * n_graphics_prv_circle_spans(uint16_t radius, uint16_t width);
+void n_graphics_circle_cache_get_stats(uint32_t * hits, uint32_t * misses);
+void n_graphics_circle_cache_reset_stats(void);
+
 void n_graphics_fill_circle(n_GContext * ctx, n_GPoint p, uint16_t radius);
 void n_graphics_draw_circle(n_GContext * ctx, n_GPoint p, uint16_t radius);
 
 void n_graphics_fill_circle_bounded(n_GContext * ctx, n_GPoint p, uint16_t radius, int16_t minx, int16_t maxx, int16_t miny, int16_t maxy);
 void n_graphics_draw_circle_bounded(n_GContext * ctx, n_GPoint p, uint16_t radius, int16_t minx, int16_t maxx, int16_t miny, int16_t maxy);
 
-void n_graphics_prv_draw_quarter_circle_bounded(n_GContext * ctx, n_GPoint p,
-    uint16_t radius, uint16_t width, int8_t x_dir, int8_t y_dir,
-    int16_t minx, int16_t maxx, int16_t miny, int16_t maxy);
-void n_graphics_prv_fill_quarter_circle_bounded(n_GContext * ctx, n_GPoint p,
-    uint16_t radius, int8_t x_dir, int8_t y_dir,
+#ifndef PBL_BW
+// (radius^2 << 16) has to fit in 32 bits
+#define N_GRAPHICS_AA_MAX_RADIUS 255
+void n_graphics_draw_circle_1px_aa_bounded(n_GContext * ctx, n_GPoint p, uint16_t radius, int16_t minx, int16_t maxx, int16_t miny, int16_t maxy);
+#endif
+
+/*!
+ * Arcs and radials. Angles run clockwise from 12 o'clock, in units of
+ * TRIG_MAX_ANGLE per turn; nothing is drawn unless angle_end > angle_start.
+ * The circle sits in the middle of rect, sized by scale_mode, and is built
+ * from the same spans as n_graphics_fill_circle, so a full turn of a
+ * radial is the filled circle. Arcs are stroke_width wide, centered on the
+ * circle; radials are inset_thickness deep from the edge inwards.
+ */
+// Arc half-widths are kept in bytes, so no bigger than this.
+#define N_GRAPHICS_ARC_MAX_RADIUS 255
+void n_graphics_draw_arc(n_GContext * ctx, n_GRect rect, n_GOvalScaleMode scale_mode,
+    int32_t angle_start, int32_t angle_end);
+void n_graphics_fill_radial(n_GContext * ctx, n_GRect rect, n_GOvalScaleMode scale_mode,
+    uint16_t inset_thickness, int32_t angle_start, int32_t angle_end);
+
+void n_graphics_prv_fill_arc_bounded(n_GContext * ctx, n_GPoint p, uint16_t outer, uint16_t inner,
+    int32_t angle_start, int32_t angle_end, uint8_t color,
     int16_t minx, int16_t maxx, int16_t miny, int16_t maxy);
@@ -20,6 +20,7 @@
 \*/
 
 #include "line.h"
+#include "../deferred/deferred.h"
 
 void n_graphics_prv_draw_1px_line_bounded(n_GContext * ctx,
                                              n_GPoint from, n_GPoint to,
@@ -43,8 +44,9 @@ void n_graphics_prv_draw_1px_line_bounded(n_GContext * ctx,
     }
     if (iterate_over_y) {
         int8_t e = (dx == 0 ? 0 : (dx > 0 ? 1 : -1));
-        int16_t begin = __BOUND_NUM(miny, from.y, maxy - 1);
-        int16_t end = __BOUND_NUM(miny, to.y, maxy - 1);
+        // clamped each way only, so a line past the clip draws nothing
+        int16_t begin = from.y > miny ? from.y : miny;
+        int16_t end = to.y < maxy - 1 ? to.y : maxy - 1;
         if (e == 0) {
 #ifdef PBL_BW
             n_graphics_prv_draw_col(ctx->fbuf, from.x, from.y, to.y,
@@ -56,6 +58,8 @@ void n_graphics_prv_draw_1px_line_bounded(n_GContext * ctx,
         } else {
             for (int16_t y = begin; y <= end; y++) {
                 int16_t x = (dx * (y-from.y) * 2 + e * dy) / (dy * 2) + from.x;
+                if (x < minx || x >= maxx)
+                    continue;
 #ifdef PBL_BW
                 n_graphics_set_pixel(ctx, n_GPoint(x, y),
                     ((color >> ((x + y) % 2)) & 1) ?
@@ -68,8 +72,8 @@ void n_graphics_prv_draw_1px_line_bounded(n_GContext * ctx,
         }
     } else {
         int8_t e = (dy == 0 ? 0 : (dy > 0 ? 1 : -1));
-        int16_t begin = __BOUND_NUM(minx, from.x, maxx - 1);
-        int16_t end = __BOUND_NUM(minx, to.x, maxx - 1);
+        int16_t begin = from.x > minx ? from.x : minx;
+        int16_t end = to.x < maxx - 1 ? to.x : maxx - 1;
         if (e == 0) {
 #ifdef PBL_BW
             n_graphics_prv_draw_row(ctx->fbuf, from.y, from.x, to.x,
@@ -81,6 +85,8 @@ void n_graphics_prv_draw_1px_line_bounded(n_GContext * ctx,
         } else {
             for (int16_t x = begin; x <= end; x++) {
                 int16_t y = (dy * (x-from.x) * 2 + e * dx) / (dx * 2) + from.y;
+                if (y < miny || y >= maxy)
+                    continue;
 #ifdef PBL_BW
                 n_graphics_set_pixel(ctx, n_GPoint(x, y),
                     ((color >> ((x + y) % 2)) & 1) ?
@@ -94,143 +100,199 @@ void n_graphics_prv_draw_1px_line_bounded(n_GContext * ctx,
     }
 }
 
-static uint16_t prv_fast_int_sqrt(uint16_t in) {
-    uint16_t a = 1, b = in;
-    while (abs(a - b) > 1) { // unrolled to 3 runs/iter for speed
-        b = in / a;
-        a = (a + b) / 2;
-        if (!abs(a - b) > 1)
-            return a;
-        b = in / a;
-        a = (a + b) / 2;
-        if (!abs(a - b) > 1)
-            return a;
-        b = in / a;
-        a = (a + b) / 2;
+#ifndef PBL_BW
+// Wu's line: along the major axis, the two pixels straddling the ideal line
+// share one pixel's worth of coverage by how close each is to it.
+void n_graphics_prv_draw_1px_line_aa_bounded(n_GContext * ctx,
+                                                n_GPoint from, n_GPoint to,
+                                                int16_t minx, int16_t maxx,
+                                                int16_t miny, int16_t maxy) {
+    uint8_t color = ctx->stroke_color.argb;
+    int16_t dy = (to.y - from.y), dx = (to.x - from.x);
+    bool iterate_over_y = abs(dy) > abs(dx);
+    if (    (iterate_over_y && dy < 0) ||
+           (!iterate_over_y && dx < 0)) {
+        n_GPoint temp = from;
+        from = to;
+        to = temp;
+        dy = -dy;
+        dx = -dx;
+    }
+    if (iterate_over_y) {
+        // 16.16 fixed point minor coordinate, stepped per line
+        int32_t step = ((int32_t) dx * 65536) / dy;
+        int16_t begin = from.y > miny ? from.y : miny,
+                end   = to.y < maxy - 1 ? to.y : maxy - 1;
+        int32_t pos = ((int32_t) from.x * 65536) + step * (begin - from.y);
+        for (int16_t y = begin; y <= end; y++, pos += step) {
+            int16_t x = pos >> 16;
+            uint8_t frac = (pos >> 8) & 0xFF;
+            n_graphics_prv_blend_pixel(ctx->fbuf, x, y, minx, maxx, miny, maxy,
+                                       color, 255 - frac);
+            n_graphics_prv_blend_pixel(ctx->fbuf, x + 1, y, minx, maxx, miny, maxy,
+                                       color, frac);
+        }
+    } else {
+        int32_t step = ((int32_t) dy * 65536) / dx;
+        int16_t begin = from.x > minx ? from.x : minx,
+                end   = to.x < maxx - 1 ? to.x : maxx - 1;
+        int32_t pos = ((int32_t) from.y * 65536) + step * (begin - from.x);
+        for (int16_t x = begin; x <= end; x++, pos += step) {
+            int16_t y = pos >> 16;
+            uint8_t frac = (pos >> 8) & 0xFF;
+            n_graphics_prv_blend_pixel(ctx->fbuf, x, y, minx, maxx, miny, maxy,
+                                       color, 255 - frac);
+            n_graphics_prv_blend_pixel(ctx->fbuf, x, y + 1, minx, maxx, miny, maxy,
+                                       color, frac);
+        }
     }
-    return a;
 }
+#endif
 
-void n_graphics_prv_draw_thick_line_bounded(n_GContext * ctx,
-                                               n_GPoint from, n_GPoint to,
-                                               uint8_t width,
-                                               int16_t minx, int16_t maxx,
-                                               int16_t miny, int16_t maxy) {
-    uint16_t radius = (width - 1) / 2;
-    if (ctx->stroke_caps) {
-        n_GColor tmp_fill = ctx->fill_color;
-        ctx->fill_color = ctx->stroke_color;
-        n_graphics_fill_circle_bounded(ctx, from, radius, minx, maxx, miny, maxy);
-        n_graphics_fill_circle_bounded(ctx, to, radius, minx, maxx, miny, maxy);
-        ctx->fill_color = tmp_fill;
-    }
-    // At this point (see what I did there?), we have to calculate the points
-    // which allow us to connect the two drawn circles.
+// Thick lines are filled as one convex shape: the quad around the segment,
+// plus a round cap at each end when stroke caps are on. Every scanline of
+// that shape is a single span, so each pixel is written once.
+//
+// The maths is in fixed point. A pixel is in if the point just below and
+// right of its center is, which makes the edges half-open: a width 2
+// horizontal line covers exactly two rows.
 
-    // SO, here's what we do: we use an integer which keeps being upped until
-    // we reach the point where the point translated by a part of the dx/dy pair
-    // hits the circle's radius roundabout in the right spot.
+#define __LINE_FRAC_BITS 4
+#define __LINE_ONE (1 << __LINE_FRAC_BITS)
 
-    int16_t dx = to.x - from.x, dy = to.y - from.y;
-    if (dx > 100) {
-        dy = dy * 100 / dx;
-        dx = 100;
-    } else if (dy > 100) {
-        dx = dx * 100 / dy;
-        dy = 100;
-    }
+// A point in that fixed point. Off-screen ends are fine, so this is wider
+// than an n_GPoint.
+typedef struct {
+    int32_t x, y;
+} n_prv_LinePoint;
 
-    n_GPoint from_a = from,
-             to_a = to,
-             from_b = from,
-             to_b = to;
-    uint16_t multiplier = 1;
-    int16_t sep_dx, sep_dy;
-    if (dx == 0) {
-        sep_dx = 0;
-        sep_dy = width / 2;
-    } else if (dy == 0) {
-        sep_dx = width / 2;
-        sep_dy = 0;
+// Widens [*left, *right] to where the edge p-q meets the scanline y_fp.
+static void prv_edge_span(n_prv_LinePoint p, n_prv_LinePoint q, int32_t y_fp,
+                          int32_t * left, int32_t * right) {
+    if ((y_fp < p.y && y_fp < q.y) || (y_fp > p.y && y_fp > q.y))
+        return;
+    int32_t x0, x1;
+    if (p.y == q.y) {
+        x0 = p.x;
+        x1 = q.x;
     } else {
-        // We're doing a search where we step forward in 100s.
-        for (multiplier = 1; multiplier < 40000; multiplier += 10) {
-            sep_dx = dx * multiplier / 100;
-            sep_dy = dy * multiplier / 100;
-            if (prv_fast_int_sqrt(sep_dx * sep_dx + sep_dy * sep_dy) > width / 2) {
-                break;
-            }
-        }
-        uint16_t rooted = 0;
-        // ...and then step back in 1s.
-        do {
-            multiplier -= 1;
-            sep_dx = dx * multiplier / 100;
-            sep_dy = dy * multiplier / 100;
-            rooted = prv_fast_int_sqrt(sep_dx * sep_dx + sep_dy * sep_dy);
-        } while (multiplier > 1 && rooted > width / 2);
-
-        sep_dx = dx * multiplier / 100;
-        sep_dy = dy * multiplier / 100;
+        x0 = x1 = p.x + (int64_t) (y_fp - p.y) * (q.x - p.x) / (q.y - p.y);
     }
+    if (x0 > x1) {
+        int32_t tmp = x0;
+        x0 = x1;
+        x1 = tmp;
+    }
+    if (x0 < *left) *left = x0;
+    if (x1 > *right) *right = x1;
+}
 
-    from_a.x -= sep_dy;
-    from_a.y += sep_dx;
-    to_a.x -= sep_dy;
-    to_a.y += sep_dx;
-
-    from_b.x += sep_dy;
-    from_b.y -= sep_dx;
-    to_b.x += sep_dy;
-    to_b.y -= sep_dx;
+// n_graphics_prv_int_sqrt for lengths too long for 32 bits once squared.
+static uint32_t prv_sqrt64(uint64_t in) {
+    uint64_t res = 0, bit = 1ull << 62;
+    while (bit > in)
+        bit >>= 2;
+    while (bit) {
+        if (in >= res + bit) {
+            in -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
 
-    int8_t xdir = (from_a.x > from_b.x ? -1 : 1);
-    int8_t ydir = (from_a.y > from_b.y ? -1 : 1);
+// Widens [*left, *right] to a round cap of radius r_fp around c.
+static void prv_cap_span(n_GPoint c, int32_t r_fp, int32_t y_fp,
+                         int32_t * left, int32_t * right) {
+    int32_t dy = y_fp - c.y * __LINE_ONE;
+    if (dy < -r_fp || dy > r_fp)
+        return;
+    int32_t chord = n_graphics_prv_int_sqrt(r_fp * r_fp - dy * dy);
+    if (c.x * __LINE_ONE - chord < *left) *left = c.x * __LINE_ONE - chord;
+    if (c.x * __LINE_ONE + chord > *right) *right = c.x * __LINE_ONE + chord;
+}
 
-    n_graphics_prv_draw_1px_line_bounded(ctx, from_a, to_a, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
-    n_graphics_prv_draw_1px_line_bounded(ctx, from_b, to_b, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+void n_graphics_prv_draw_thick_line_bounded(n_GContext * ctx,
+                                               n_GPoint from, n_GPoint to,
+                                               uint8_t width,
+                                               int16_t minx, int16_t maxx,
+                                               int16_t miny, int16_t maxy) {
+#ifdef PBL_BW
+    uint8_t color = __ARGB_TO_INTERNAL(ctx->stroke_color.argb);
+#else
+    uint8_t color = ctx->stroke_color.argb;
+#endif
+    int32_t half = width * __LINE_ONE / 2,
+            dx = to.x - from.x, dy = to.y - from.y;
+    bool has_quad = (dx != 0 || dy != 0),
+         caps = ctx->stroke_caps || !has_quad;
 
-    if (!ctx->stroke_caps || true) {
-        // TODO this doesn't look good yet:tm: because the translated line
-        // isn't always fully contained within the stroke.
-        n_graphics_prv_draw_1px_line_bounded(ctx, from_a, from_b, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
-        n_graphics_prv_draw_1px_line_bounded(ctx, to_a, to_b, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+    // The quad's corners are the ends pushed out by half the width either
+    // side, along the normal (-dy, dx) / len.
+    n_prv_LinePoint quad[4];
+    if (has_quad) {
+        int32_t len = prv_sqrt64((uint64_t) ((int64_t) dx * dx + (int64_t) dy * dy)
+                                 << (2 * __LINE_FRAC_BITS)),
+                nx = (int64_t) -dy * half * __LINE_ONE / len,
+                ny = (int64_t) dx * half * __LINE_ONE / len;
+        int32_t ax = from.x * __LINE_ONE, ay = from.y * __LINE_ONE,
+                bx = to.x * __LINE_ONE, by = to.y * __LINE_ONE;
+        quad[0] = (n_prv_LinePoint) { ax + nx, ay + ny };
+        quad[1] = (n_prv_LinePoint) { bx + nx, by + ny };
+        quad[2] = (n_prv_LinePoint) { bx - nx, by - ny };
+        quad[3] = (n_prv_LinePoint) { ax - nx, ay - ny };
     }
 
-    bool change_x = false;
-    while (from_a.x != from_b.x || from_a.y != from_b.y) {
-        if (ctx->stroke_caps) {
-            // simple, quick algo
-            // used for round caps to save those precious cpu cycles
-            change_x = abs(from_b.x - from_a.x) > abs(from_b.y - from_a.y);
-        } else {
-            // expensive division: only run this when it's
-            // actually needed (i.e. when stroke caps are hidden.)
-            change_x = (from_a.y == from_b.y ||
-                         (from_a.x != from_b.x &&
-                          abs(((from_a.x - from_b.x) << 3) / sep_dy) >
-                          abs(((from_a.y - from_b.y) << 3) / sep_dx)));
-        }
-        if (change_x) {
-            from_a.x += xdir;
-            to_a.x += xdir;
-        } else {
-            from_a.y += ydir;
-            to_a.y += ydir;
+    int32_t top = (from.y < to.y ? from.y : to.y) - width / 2 - 1,
+            bottom = (from.y > to.y ? from.y : to.y) + width / 2 + 1;
+    top = __BOUND_NUM(miny, top, maxy);
+    bottom = __BOUND_NUM(miny - 1, bottom, maxy - 1);
+
+    for (int16_t y = top; y <= bottom; y++) {
+        int32_t y_fp = y * __LINE_ONE + 1,
+                left = INT32_MAX, right = INT32_MIN;
+        if (has_quad)
+            for (uint8_t i = 0; i < 4; i++)
+                prv_edge_span(quad[i], quad[(i + 1) % 4], y_fp, &left, &right);
+        if (caps) {
+            prv_cap_span(from, half, y_fp, &left, &right);
+            prv_cap_span(to, half, y_fp, &left, &right);
         }
-        n_graphics_prv_draw_1px_line_bounded(ctx, from_a, to_a, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
-        n_graphics_prv_draw_1px_line_bounded(ctx, from_b, to_b, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+        if (left > right)
+            continue;
+        // pixels whose sample point (x + 1/16) lies within [left, right]
+        left = (left - 1 + __LINE_ONE - 1) >> __LINE_FRAC_BITS;
+        right = (right - 1) >> __LINE_FRAC_BITS;
+        // the row takes int16s, and far off ends can be out of their range
+        if (left < minx)
+            left = minx;
+        if (right > maxx - 1)
+            right = maxx - 1;
+        if (left <= right)
+            n_graphics_prv_draw_row(ctx->fbuf, y, left, right,
+                                    minx, maxx, miny, maxy, color);
     }
 }
 
 void n_graphics_draw_line(n_GContext * ctx, n_GPoint from, n_GPoint to) {
-    // TODO check layer bounds
     if (ctx->stroke_width == 0 || !(ctx->stroke_color.argb & (0b11 << 6)))
         return;
+    else if (ctx->deferred)
+        n_graphics_prv_defer_line(ctx, from, to);
+#ifndef PBL_BW
+    // straight lines have nothing to smooth
+    else if (ctx->stroke_width == 1 && ctx->antialias &&
+             from.x != to.x && from.y != to.y)
+        n_graphics_prv_draw_1px_line_aa_bounded(ctx, from, to,
+            __CLIP_BOUNDS(ctx));
+#endif
     else if (ctx->stroke_width == 1)
         n_graphics_prv_draw_1px_line_bounded(ctx, from, to,
-            0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+            __CLIP_BOUNDS(ctx));
     else
         n_graphics_prv_draw_thick_line_bounded(ctx, from, to, ctx->stroke_width,
-            0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+            __CLIP_BOUNDS(ctx));
 }
@@ -27,6 +27,11 @@
 void n_graphics_prv_draw_1px_line_bounded(
     n_GContext * ctx, n_GPoint from, n_GPoint to,
     int16_t minx, int16_t maxx, int16_t miny, int16_t maxy);
+#ifndef PBL_BW
+void n_graphics_prv_draw_1px_line_aa_bounded(
+    n_GContext * ctx, n_GPoint from, n_GPoint to,
+    int16_t minx, int16_t maxx, int16_t miny, int16_t maxy);
+#endif
 void n_graphics_prv_draw_thick_line_bounded(
     n_GContext * ctx, n_GPoint from, n_GPoint to, uint8_t width,
     int16_t minx, int16_t maxx, int16_t miny, int16_t maxy);
@@ -20,6 +20,7 @@
 \*/
 
 #include "rect.h"
+#include "../deferred/deferred.h"
 
 
 static void n_graphics_draw_thin_rect_bounded(
@@ -30,18 +31,67 @@ static void n_graphics_draw_thin_rect_bounded(
 #else
     uint8_t color = ctx->stroke_color.argb;
 #endif
-    n_graphics_prv_draw_col(ctx->fbuf, rect.origin.x,
-            rect.origin.y, rect.origin.y + rect.size.h - 1,
+    int16_t left = rect.origin.x,
+            right = rect.origin.x + rect.size.w - 1,
+            top = rect.origin.y,
+            bottom = rect.origin.y + rect.size.h - 1;
+    // the rows take the corners, so no pixel is drawn twice
+    n_graphics_prv_draw_row(ctx->fbuf, top, left, right,
             minx, maxx, miny, maxy, color);
-    n_graphics_prv_draw_row(ctx->fbuf, rect.origin.y,
-            rect.origin.x, rect.origin.x + rect.size.w - 1,
-            minx, maxx, miny, maxy, color);
-    n_graphics_prv_draw_col(ctx->fbuf, rect.origin.x + rect.size.w - 1,
-            rect.origin.y, rect.origin.y + rect.size.h - 1,
-            minx, maxx, miny, maxy, color);
-    n_graphics_prv_draw_row(ctx->fbuf, rect.origin.y + rect.size.h - 1,
-            rect.origin.x, rect.origin.x + rect.size.w - 1,
+    if (bottom != top)
+        n_graphics_prv_draw_row(ctx->fbuf, bottom, left, right,
+                minx, maxx, miny, maxy, color);
+    n_graphics_prv_draw_col(ctx->fbuf, left, top + 1, bottom - 1,
             minx, maxx, miny, maxy, color);
+    if (right != left)
+        n_graphics_prv_draw_col(ctx->fbuf, right, top + 1, bottom - 1,
+                minx, maxx, miny, maxy, color);
+}
+
+/*\
+|*| Rounded corners
+|*|
+|*| Corners come from the circle span tables (see circle.c), looked up once
+|*| per rect: the filled table for fills and 1px outlines, the ring table
+|*| for thicker strokes. Everything else is whole rows or a few spans per
+|*| row, so a rounded rect costs little more than a square one. Radii are
+|*| capped so the corner still fits in the table.
+\*/
+
+// One corner's span on the row dy away from its center, or false if the
+// corner doesn't reach that row. x_dir points away from the rect's middle.
+static bool n_prv_corner_span(const n_GCircleSpans * corner, bool outline,
+        int16_t cx, int8_t x_dir, int16_t dy, int16_t * from, int16_t * to) {
+    if (dy < 0 || dy >= corner->rows)
+        return false;
+    int16_t outer = corner->outer[dy], inner;
+    if (outline) {
+        // just the edge of the filled quarter: down to where the row
+        // further out stops
+        inner = (dy + 1 < corner->rows) ? corner->outer[dy + 1] + 1 : 0;
+        if (inner > outer)
+            inner = outer;
+    } else {
+        inner = corner->hole[dy];
+    }
+    *from = (x_dir < 0) ? cx - outer : cx + inner;
+    *to = (x_dir < 0) ? cx - inner : cx + outer;
+    return true;
+}
+
+// Adds [from, to] to a row's spans, kept sorted by their left end.
+static uint8_t n_prv_add_span(int16_t spans[][2], uint8_t count, int16_t from, int16_t to) {
+    if (to < from)
+        return count;
+    uint8_t i = count;
+    while (i && spans[i - 1][0] > from) {
+        spans[i][0] = spans[i - 1][0];
+        spans[i][1] = spans[i - 1][1];
+        i--;
+    }
+    spans[i][0] = from;
+    spans[i][1] = to;
+    return count + 1;
 }
 
 static void n_graphics_draw_rect_bounded(
@@ -49,60 +99,109 @@ static void n_graphics_draw_rect_bounded(
         uint16_t minx, uint16_t maxx, uint16_t miny, uint16_t maxy) {
     // NB this could be changed in the future to allow for more shapes, for
     // example one with opposite corners rounded & radius equal to width.
-
+    uint16_t width = ctx->stroke_width,
+             line_radius = (width - 1) / 2,
+             // sides cover the same rows and columns as a line would
+             outside = width / 2;
+#ifdef PBL_BW
+    uint8_t color = __ARGB_TO_INTERNAL(ctx->stroke_color.argb);
+#else
+    uint8_t color = ctx->stroke_color.argb;
+#endif
 
     radius = __BOUND_NUM(0, __BOUND_NUM(0, radius, rect.size.h / 2), rect.size.w / 2);
+    if (radius + line_radius > N_GRAPHICS_CIRCLE_CACHE_MAX_RADIUS)
+        radius = line_radius < N_GRAPHICS_CIRCLE_CACHE_MAX_RADIUS
+               ? N_GRAPHICS_CIRCLE_CACHE_MAX_RADIUS - line_radius : 0;
+    if (radius == 0)
+        mask = n_GCornerNone;
+
+    int16_t left = rect.origin.x,
+            right = rect.origin.x + rect.size.w - 1,
+            top = rect.origin.y,
+            bottom = rect.origin.y + rect.size.h - 1;
+
+    // Sides stop one short of a rounded corner's center, which the corner
+    // draws; square corners are filled in by the top and bottom sides.
+    int16_t bottom_from = bottom - outside,
+            right_from = right - outside;
+    int16_t top_l = (mask & n_GCornerTopLeft) ? left + radius + 1 : left - outside,
+            top_r = (mask & n_GCornerTopRight) ? right - radius - 1 : right + line_radius,
+            bottom_l = (mask & n_GCornerBottomLeft) ? left + radius + 1 : left - outside,
+            bottom_r = (mask & n_GCornerBottomRight) ? right - radius - 1 : right + line_radius,
+            left_t = (mask & n_GCornerTopLeft) ? top + radius + 1 : top + line_radius + 1,
+            left_b = (mask & n_GCornerBottomLeft) ? bottom - radius - 1 : bottom - outside - 1,
+            right_t = (mask & n_GCornerTopRight) ? top + radius + 1 : top + line_radius + 1,
+            right_b = (mask & n_GCornerBottomRight) ? bottom - radius - 1 : bottom - outside - 1;
+
+    // a 1px stroke is the edge of the fill, thicker ones are cached rings
+    bool outline = width <= 1;
+    const n_GCircleSpans * corner = NULL;
+    if (mask & n_GCornersAll)
+        corner = n_graphics_prv_circle_spans(radius, outline ? 0 : width);
+    int16_t c_top = top + radius, c_bottom = bottom - radius,
+            c_left = left + radius, c_right = right - radius;
+
+    // Between the corners there are only the left and right sides.
+    int16_t mid_top = top + line_radius + 1,
+            mid_bottom = bottom_from - 1;
+    if ((mask & (n_GCornerTopLeft | n_GCornerTopRight)) && mid_top <= c_top)
+        mid_top = c_top + 1;
+    if ((mask & (n_GCornerBottomLeft | n_GCornerBottomRight)) && mid_bottom >= c_bottom)
+        mid_bottom = c_bottom - 1;
+    if (right_from <= left + line_radius + 1) {
+        n_graphics_prv_draw_rows(ctx->fbuf, mid_top, mid_bottom,
+            left - outside, right + line_radius, minx, maxx, miny, maxy, color);
+    } else {
+        n_graphics_prv_draw_rows(ctx->fbuf, mid_top, mid_bottom,
+            left - outside, left + line_radius, minx, maxx, miny, maxy, color);
+        n_graphics_prv_draw_rows(ctx->fbuf, mid_top, mid_bottom,
+            right_from, right + line_radius, minx, maxx, miny, maxy, color);
+    }
 
-    // NB potential for more optimization; b/w currently runs at half speed of color.
-
-    if (mask & n_GCornerTopLeft)
-        n_graphics_prv_draw_quarter_circle_bounded(ctx,
-                n_GPoint(rect.origin.x + radius,
-                         rect.origin.y + radius),
-                radius, ctx->stroke_width, -1, -1, minx, maxx, miny, maxy);
-    if (mask & n_GCornerTopRight)
-        n_graphics_prv_draw_quarter_circle_bounded(ctx,
-                n_GPoint(rect.origin.x + rect.size.w - radius - 1,
-                         rect.origin.y + radius),
-                radius, ctx->stroke_width, 1, -1, minx, maxx, miny, maxy);
-    if (mask & n_GCornerBottomLeft)
-        n_graphics_prv_draw_quarter_circle_bounded(ctx,
-                n_GPoint(rect.origin.x + radius,
-                         rect.origin.y + rect.size.h - radius - 1),
-                radius, ctx->stroke_width, -1, 1, minx, maxx, miny, maxy);
-    if (mask & n_GCornerBottomRight)
-        n_graphics_prv_draw_quarter_circle_bounded(ctx,
-                n_GPoint(rect.origin.x + rect.size.w - radius - 1,
-                         rect.origin.y + rect.size.h - radius - 1),
-                radius, ctx->stroke_width, 1, 1, minx, maxx, miny, maxy);
-
-    // NB potential for optimization by disabling unnecessary stroke caps
-
-    // Connect corners to each other clockwise.
-    n_graphics_draw_line(ctx,
-        n_GPoint(rect.origin.x + (mask & n_GCornerTopLeft ? radius : 0),
-                 rect.origin.y),
-        n_GPoint(rect.origin.x + rect.size.w - 1
-                               - (mask & n_GCornerTopRight ? radius : 0),
-                 rect.origin.y));
-    n_graphics_draw_line(ctx,
-        n_GPoint(rect.origin.x + rect.size.w - 1,
-                 rect.origin.y + (mask & n_GCornerTopRight ? radius : 0)),
-        n_GPoint(rect.origin.x + rect.size.w - 1,
-                 rect.origin.y + rect.size.h - 1
-                               - (mask & n_GCornerBottomRight ? radius : 0)));
-    n_graphics_draw_line(ctx,
-        n_GPoint(rect.origin.x + rect.size.w - 1
-                               - (mask & n_GCornerBottomRight ? radius : 0),
-                 rect.origin.y + rect.size.h - 1),
-        n_GPoint(rect.origin.x + (mask & n_GCornerBottomLeft ? radius : 0),
-                 rect.origin.y + rect.size.h - 1));
-    n_graphics_draw_line(ctx,
-        n_GPoint(rect.origin.x,
-                 rect.origin.y + rect.size.h - 1
-                               - (mask & n_GCornerBottomLeft ? radius : 0)),
-        n_GPoint(rect.origin.x,
-                 rect.origin.y + (mask & n_GCornerTopLeft ? radius : 0)));
+    // Elsewhere small radii on thick strokes, and rects about two radii
+    // across, make the sides and corners overlap. Each row's pieces are
+    // merged before drawing, so a translucent stroke blends nothing twice.
+    int16_t y0 = __BOUND_NUM(miny, top - outside, maxy),
+            y1 = __BOUND_NUM(miny - 1, bottom + line_radius, maxy - 1);
+    for (int16_t y = y0; y <= y1; y++) {
+        if (y >= mid_top && y <= mid_bottom) {
+            y = mid_bottom;
+            continue;
+        }
+        int16_t spans[8][2], from, to;
+        uint8_t count = 0;
+        if (y <= top + line_radius)
+            count = n_prv_add_span(spans, count, top_l, top_r);
+        if (y >= bottom_from)
+            count = n_prv_add_span(spans, count, bottom_l, bottom_r);
+        if (y >= left_t && y <= left_b)
+            count = n_prv_add_span(spans, count, left - outside, left + line_radius);
+        if (y >= right_t && y <= right_b)
+            count = n_prv_add_span(spans, count, right_from, right + line_radius);
+        if ((mask & n_GCornerTopLeft) &&
+                n_prv_corner_span(corner, outline, c_left, -1, c_top - y, &from, &to))
+            count = n_prv_add_span(spans, count, from, to);
+        if ((mask & n_GCornerTopRight) &&
+                n_prv_corner_span(corner, outline, c_right, 1, c_top - y, &from, &to))
+            count = n_prv_add_span(spans, count, from, to);
+        if ((mask & n_GCornerBottomLeft) &&
+                n_prv_corner_span(corner, outline, c_left, -1, y - c_bottom, &from, &to))
+            count = n_prv_add_span(spans, count, from, to);
+        if ((mask & n_GCornerBottomRight) &&
+                n_prv_corner_span(corner, outline, c_right, 1, y - c_bottom, &from, &to))
+            count = n_prv_add_span(spans, count, from, to);
+
+        for (uint8_t i = 0; i < count; ) {
+            from = spans[i][0];
+            to = spans[i][1];
+            for (i++; i < count && spans[i][0] <= to + 1; i++)
+                if (spans[i][1] > to)
+                    to = spans[i][1];
+            n_graphics_prv_draw_row(ctx->fbuf, y, from, to,
+                                    minx, maxx, miny, maxy, color);
+        }
+    }
 }
 
 n_GPoint n_graphics_center_point_rect(n_GRect *rect)
@@ -114,27 +213,52 @@ n_GPoint n_graphics_center_point_rect(n_GRect *rect)
 }
 
 void n_graphics_draw_thin_rect(n_GContext * ctx, n_GRect rect) {
-    n_graphics_draw_thin_rect_bounded(ctx, n_grect_standardize(rect), 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+    if (ctx->deferred)
+        n_graphics_prv_defer_rect(ctx, n_GDeferredOpDrawThinRect, rect, 0, n_GCornerNone);
+    else
+        n_graphics_draw_thin_rect_bounded(ctx, n_grect_standardize(rect), __CLIP_BOUNDS(ctx));
 }
 
 void n_graphics_draw_rect(n_GContext * ctx, n_GRect rect, uint16_t radius, n_GCornerMask mask) {
     if (!(ctx->stroke_color.argb & (0b11 << 6)))
         ;
+    else if (ctx->deferred)
+        n_graphics_prv_defer_rect(ctx, n_GDeferredOpDrawRect, rect, radius, mask);
     else if (ctx->stroke_width == 1 && (radius == 0 || mask == 0))
-        n_graphics_draw_thin_rect_bounded(ctx, n_grect_standardize(rect), 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+        n_graphics_draw_thin_rect_bounded(ctx, n_grect_standardize(rect), __CLIP_BOUNDS(ctx));
     else
-        n_graphics_draw_rect_bounded(ctx, n_grect_standardize(rect), radius, mask, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+        n_graphics_draw_rect_bounded(ctx, n_grect_standardize(rect), radius, mask, __CLIP_BOUNDS(ctx));
+}
+
+// One row of a fill, inset by the corners on either side.
+static void n_prv_fill_corner_row(uint8_t * fb, int16_t y, int16_t left, int16_t right,
+        uint16_t radius, int16_t inset, bool round_left, bool round_right,
+        int16_t minx, int16_t maxx, int16_t miny, int16_t maxy, uint8_t color) {
+    int16_t from = round_left ? left + inset : left,
+            to = round_right ? right - inset : right;
+    if (round_left && round_right) {
+        // two radii wide: the corners' center columns sit side by side
+        if (from > right - radius)
+            from = right - radius;
+        if (to < left + radius)
+            to = left + radius;
+    }
+    n_graphics_prv_draw_row(fb, y, from, to, minx, maxx, miny, maxy, color);
 }
 
 static void n_graphics_fill_rect_bounded(n_GContext * ctx, n_GRect rect, uint16_t radius, n_GCornerMask mask,
         uint16_t minx, uint16_t maxx, uint16_t miny, uint16_t maxy) {
     // NB this could be changed in the future to allow for more shapes, for
     // example one with opposite corners rounded & radius equal to width.:
+    // like the square fill, a rect with no area draws nothing
+    if (rect.size.w <= 0 || rect.size.h <= 0)
+        return;
     if (!(mask & 0b1111)) {
         radius = 0;
     } else {
         radius = __BOUND_NUM(0, radius, rect.size.w / 2);
         radius = __BOUND_NUM(0, radius, rect.size.h / 2);
+        radius = __BOUND_NUM(0, radius, N_GRAPHICS_CIRCLE_CACHE_MAX_RADIUS);
     }
 
 #ifdef PBL_BW
@@ -143,51 +267,31 @@ static void n_graphics_fill_rect_bounded(n_GContext * ctx, n_GRect rect, uint16_
     uint8_t color = ctx->fill_color.argb;
 #endif
 
-    // TODO these should be inlined & full rows should be drawn to maximize speed.
-
-    if (radius) {
-        if (mask & n_GCornerTopLeft)
-            n_graphics_prv_fill_quarter_circle_bounded(ctx,
-                    n_GPoint(rect.origin.x + radius,
-                             rect.origin.y + radius),
-                    radius, -1, -1, minx, maxx, miny, maxy);
-        if (mask & n_GCornerTopRight)
-            n_graphics_prv_fill_quarter_circle_bounded(ctx,
-                    n_GPoint(rect.origin.x + rect.size.w - radius - 1,
-                             rect.origin.y + radius),
-                    radius, 1, -1, minx, maxx, miny, maxy);
-        if (mask & n_GCornerBottomLeft)
-            n_graphics_prv_fill_quarter_circle_bounded(ctx,
-                    n_GPoint(rect.origin.x + radius,
-                             rect.origin.y + rect.size.h - radius - 1),
-                    radius, -1, 1, minx, maxx, miny, maxy);
-        if (mask & n_GCornerBottomRight)
-            n_graphics_prv_fill_quarter_circle_bounded(ctx,
-                    n_GPoint(rect.origin.x + rect.size.w - radius - 1,
-                             rect.origin.y + rect.size.h - radius - 1),
-                    radius, 1, 1, minx, maxx, miny, maxy);
-
-        int16_t left_indent_top = rect.origin.x + (mask & n_GCornerTopLeft ? radius : 0),
-                right_indent_top = rect.origin.x + rect.size.w - (mask & n_GCornerTopRight ? radius : 0),
-                left_indent_bottom = rect.origin.x + (mask & n_GCornerBottomLeft ? radius : 0),
-                right_indent_bottom = rect.origin.x + rect.size.w - (mask & n_GCornerBottomRight ? radius : 0);
-
-        for (uint16_t r = 0; r <= radius; r++) {
-            n_graphics_prv_draw_row(ctx->fbuf, rect.origin.y + r,
-                left_indent_top, right_indent_top,
+    int16_t left = rect.origin.x,
+            right = rect.origin.x + rect.size.w - 1,
+            top = rect.origin.y,
+            bottom = rect.origin.y + rect.size.h - 1;
+    // When the rect is exactly two radii tall, the rows either side of the
+    // middle are full width, so there is one less corner row each end.
+    uint16_t corner_rows = 0;
+    if (radius)
+        corner_rows = radius < (rect.size.h - 1) / 2 ? radius : (rect.size.h - 1) / 2;
+
+    if (corner_rows) {
+        const n_GCircleSpans * corner = n_graphics_prv_circle_spans(radius, 0);
+        for (uint16_t r = 0; r < corner_rows; r++) {
+            int16_t inset = radius - corner->outer[radius - r];
+            n_prv_fill_corner_row(ctx->fbuf, top + r, left, right, radius, inset,
+                mask & n_GCornerTopLeft, mask & n_GCornerTopRight,
                 minx, maxx, miny, maxy, color);
-            n_graphics_prv_draw_row(ctx->fbuf, rect.origin.y + rect.size.h - 1 - r,
-                left_indent_bottom, right_indent_bottom,
+            n_prv_fill_corner_row(ctx->fbuf, bottom - r, left, right, radius, inset,
+                mask & n_GCornerBottomLeft, mask & n_GCornerBottomRight,
                 minx, maxx, miny, maxy, color);
         }
     }
 
-    int16_t right_indent = rect.origin.x + rect.size.w;
-    for (int16_t r = rect.origin.y + radius; r <= rect.origin.y + rect.size.h - radius - 1; r++) {
-        n_graphics_prv_draw_row(ctx->fbuf, r,
-            rect.origin.x, right_indent,
-            minx, maxx, miny, maxy, color);
-    }
+    n_graphics_prv_draw_rows(ctx->fbuf, top + corner_rows, bottom - corner_rows,
+        left, right, minx, maxx, miny, maxy, color);
 }
 
 static void n_graphics_fill_0rad_rect_bounded(n_GContext * ctx, n_GRect rect,
@@ -199,18 +303,18 @@ static void n_graphics_fill_0rad_rect_bounded(n_GContext * ctx, n_GRect rect,
 #endif
     int16_t right_indent = rect.origin.x + rect.size.w - 1,
             max_y = rect.origin.y + rect.size.h - 1;
-    for (int16_t r = rect.origin.y; r <= max_y; r++) {
-        n_graphics_prv_draw_row(ctx->fbuf, r,
-            rect.origin.x, right_indent,
-            minx, maxx, miny, maxy, color);
-    }
+    n_graphics_prv_draw_rows(ctx->fbuf, rect.origin.y, max_y,
+        rect.origin.x, right_indent,
+        minx, maxx, miny, maxy, color);
 }
 
 void n_graphics_fill_rect(n_GContext * ctx, n_GRect rect, uint16_t radius, n_GCornerMask mask) {
     if (!(ctx->fill_color.argb & (0b11 << 6)))
         ;
+    else if (ctx->deferred)
+        n_graphics_prv_defer_rect(ctx, n_GDeferredOpFillRect, rect, radius, mask);
     else if (radius == 0 || (mask & 0b1111) == 0)
-        n_graphics_fill_0rad_rect_bounded(ctx, rect, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+        n_graphics_fill_0rad_rect_bounded(ctx, rect, __CLIP_BOUNDS(ctx));
     else
-        n_graphics_fill_rect_bounded(ctx, rect, radius, mask, 0, __SCREEN_WIDTH, 0, __SCREEN_HEIGHT);
+        n_graphics_fill_rect_bounded(ctx, rect, radius, mask, __CLIP_BOUNDS(ctx));
 }
@@ -23,6 +23,7 @@
 #include <pebble.h>
 #include "types/color.h"
 #include "types/cornermask.h"
+#include "types/ovalscalemode.h"
 #include "types/point.h"
 #include "types/rect.h"
 #include "types/size.h"
@@ -15,6 +15,8 @@ void app_select_single_click_handler(ClickRecognizerRef recognizer, void *contex
 void app_back_single_click_handler(ClickRecognizerRef recognizer, void *context);
 
 static xQueueHandle _app_message_queue;
+/* A frame made it to the display and the app hasn't stepped for it yet */
+static volatile uint8_t _draw_done_pending;
 
 void appmanager_app_runloop_init(void)
 {
@@ -29,6 +31,25 @@ void appmanager_post_generic_app_message(AppMessage *am, TickType_t timeout)
     xQueueSendToBack(_app_message_queue, am, timeout);
 }
 
+/*
+ * A frame made it to the display. Posted from the display thread,
+ * which must not wait on the app. The flag is what counts, the message
+ * only wakes the app. If the queue is full the app is about to wake
+ * anyway, and more frames before it does only need the one step
+ */
+void appmanager_post_draw_done_message(void)
+{
+    AppMessage am = (AppMessage) {
+        .message_type_id = APP_DRAW_DONE
+    };
+    
+    if (_draw_done_pending)
+        return;
+    
+    _draw_done_pending = 1;
+    appmanager_post_generic_app_message(&am, 0);
+}
+
 /*
  * We are the main entrypoint for running a thread.
  * When we are done, we notify the main thread we shutdown
@@ -39,6 +60,9 @@ void appmanager_app_main_entry(void)
     app_running_thread *_this_thread = appmanager_get_current_thread();
     
     _this_thread->status = AppThreadLoaded;
+    /* the last app's cached paths went with its heap */
+    if (_this_thread->thread_type == AppThreadMainApp)
+        n_gpath_reset_cache();
     /* Call into the apps main runtime */
     _this_thread->app->main();
     _this_thread->status = AppThreadUnloading;
@@ -106,6 +130,13 @@ void app_event_loop(void)
         /* Is there something queued up to do?  If so, we have the potential to do it. */
         TickType_t next_timer;
         
+        if (_draw_done_pending)
+        {
+            /* the display is ready for more. Let animations step */
+            _draw_done_pending = 0;
+            animation_frame_done();
+        }
+        
         if (_this_thread->timer_head) {
             TickType_t curtime = xTaskGetTickCount();
             if (curtime > _this_thread->timer_head->when)
@@ -146,6 +177,7 @@ void app_event_loop(void)
             {
                 window_draw();
             }
+            /* APP_DRAW_DONE only wakes us, the top of the loop handles it */
         } else {
             /* We woke up because we hit a timer expiry.  Dequeue first,
              * then invoke -- otherwise someone else could insert themselves
@@ -7,29 +7,95 @@
  
 #include "rebbleos.h"
 
+/* The thread also writes the stats dump and snapshots to the log, and
+ * printf wants more than the minimal stack */
+#define DISPLAY_THREAD_STACK_SIZE (configMINIMAL_STACK_SIZE * 2)
+
 static TaskHandle_t _display_task;
-static xQueueHandle _display_queue;
 static SemaphoreHandle_t _display_mutex;
 static StaticSemaphore_t _display_mutex_buf;
 
+/* There is only ever one frame waiting to go out. Requests made while
+ * it waits are merged into it, so the newest drawing always wins */
+static SemaphoreHandle_t _display_request;
+static StaticSemaphore_t _display_request_buf;
+static volatile uint8_t _display_pending;
+static DisplayFrameCounts _display_counts;
+
+/* The area drawn since the last frame was sent. x1 and y1 are exclusive.
+ * Starts out as the whole screen so the first frame goes out in full */
+static uint8_t _display_dirty_x0 = 0;
+static uint8_t _display_dirty_y0 = 0;
+static uint8_t _display_dirty_x1 = DISPLAY_COLS;
+static uint8_t _display_dirty_y1 = DISPLAY_ROWS;
+
+/* Pipeline timing. Timestamps are cycle counts, or RTOS ticks if the
+ * cycle counter isn't running (QEMU). Every DISPLAY_STATS_LOG_FRAMES
+ * frames the lot is dumped to the log. 0 turns that off */
+#define DISPLAY_STATS_LOG_FRAMES 500
+static DisplayStatHistogram _display_stats[DisplayStatMax];
+static uint8_t _display_stat_cycles;
+static uint32_t _display_stat_cycles_per_us;
+
+/* Snapshots go out over the debug port as text, one framebuffer row per
+ * line. Only rows that changed since the last snapshot are written, each
+ * run length encoded. Utilities/snapshot_decode.py turns them into PNGs.
+ * Changes are spotted by a hash of each row, and a change the hash misses
+ * would stick, so every SNAPSHOT_KEYFRAME_INTERVAL'th snapshot sends all
+ * the rows regardless */
+#ifdef PBL_BW
+#define SNAPSHOT_ROW_BYTES 20
+#define SNAPSHOT_BPP 1
+#else
+#define SNAPSHOT_ROW_BYTES DISPLAY_COLS
+#define SNAPSHOT_BPP 8
+#endif
+#define SNAPSHOT_KEYFRAME_INTERVAL 32
+// worst case is a literal header every 128 bytes
+#define SNAPSHOT_RLE_MAX (SNAPSHOT_ROW_BYTES + SNAPSHOT_ROW_BYTES / 128 + 1)
+static uint32_t _snapshot_hash[DISPLAY_ROWS];
+/* only one snapshot at a time, they share their buffers and hashes */
+static SemaphoreHandle_t _snapshot_mutex;
+static StaticSemaphore_t _snapshot_mutex_buf;
+static uint32_t _snapshot_seq;
+static uint8_t _snapshot_stream;
+
+#ifdef DISPLAY_DOUBLE_BUFFER
+/* Apps draw into the back buffer while the driver sends the front one.
+ * display_draw swaps them, which can only happen between frames */
+static uint8_t _display_framebuffer[MAX_FRAMEBUFFER_SIZE] __attribute__((aligned(4)));
+static uint8_t *_display_front;
+static uint8_t *_display_back;
+#endif
+
 static void _display_thread(void *pvParameters);
-static void _display_start_frame(uint8_t offset_x, uint8_t offset_y);
-static void _display_cmd(uint8_t cmd, char *data);
+static void _display_start_frame(void);
+static void _display_request_frame(void);
+static void _display_stat_init(void);
 
 /*
  * Start the display driver and tasks. Show splash
  */
 void display_init(void)
 {   
+    _display_stat_init();
     hw_display_init();
+    
+#ifdef DISPLAY_DOUBLE_BUFFER
+    // the driver's own buffer holds the splash, so show that first
+    _display_front = hw_display_get_buffer();
+    _display_back = _display_framebuffer;
+    hw_display_set_buffer(_display_front);
+#endif
       
     // set up the RTOS tasks
-    xTaskCreate(_display_thread, "Display", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 2UL, &_display_task);
+    xTaskCreate(_display_thread, "Display", DISPLAY_THREAD_STACK_SIZE, NULL, tskIDLE_PRIORITY + 2UL, &_display_task);
     
-    _display_queue = xQueueCreate(2, sizeof(uint8_t));
+    _display_request = xSemaphoreCreateBinaryStatic(&_display_request_buf);
     _display_mutex = xSemaphoreCreateMutexStatic(&_display_mutex_buf);
+    _snapshot_mutex = xSemaphoreCreateMutexStatic(&_snapshot_mutex_buf);
     
-    _display_cmd(DISPLAY_CMD_DRAW, NULL);
+    _display_request_frame();
     
     KERN_LOG("Display", APP_LOG_LEVEL_INFO, "Display Tasks Created");
 }
@@ -64,18 +130,84 @@ void display_reset(uint8_t enabled)
     hw_display_reset();
 }
 
+/*
+ * Grow the dirty area to cover the given rectangle, clipped to the screen
+ */
+static void _display_mark_dirty(int16_t x, int16_t y, int16_t width, int16_t height)
+{
+    int16_t x1 = x + width;
+    int16_t y1 = y + height;
+    
+    if (x < 0)
+        x = 0;
+    if (y < 0)
+        y = 0;
+    if (x1 > DISPLAY_COLS)
+        x1 = DISPLAY_COLS;
+    if (y1 > DISPLAY_ROWS)
+        y1 = DISPLAY_ROWS;
+    
+    if (x >= x1 || y >= y1)
+        return;
+    
+    taskENTER_CRITICAL();
+    if (_display_dirty_x0 >= _display_dirty_x1)
+    {
+        _display_dirty_x0 = x;
+        _display_dirty_y0 = y;
+        _display_dirty_x1 = x1;
+        _display_dirty_y1 = y1;
+    }
+    else
+    {
+        if (x < _display_dirty_x0)
+            _display_dirty_x0 = x;
+        if (y < _display_dirty_y0)
+            _display_dirty_y0 = y;
+        if (x1 > _display_dirty_x1)
+            _display_dirty_x1 = x1;
+        if (y1 > _display_dirty_y1)
+            _display_dirty_y1 = y1;
+    }
+    taskEXIT_CRITICAL();
+}
+
 /*
  * Begin rendering a frame from the framebuffer into the display
+ * The mutex is held until the frame is out, so with double buffering
+ * the front buffer can't be swapped from under the driver
+ *
+ * Only the area drawn since the last frame is passed down. If nothing
+ * was drawn, there is nothing to send
  */
-static void _display_start_frame(uint8_t xoffset, uint8_t yoffset)
+static void _display_start_frame(void)
 {
+    uint8_t x, y, w, h;
+    
     xSemaphoreTake(_display_mutex, portMAX_DELAY);
     
-    hw_display_start_frame(xoffset, yoffset);
+    // from here on, new requests are for the next frame
+    taskENTER_CRITICAL();
+    _display_pending = 0;
+    x = _display_dirty_x0;
+    y = _display_dirty_y0;
+    w = _display_dirty_x1 > x ? _display_dirty_x1 - x : 0;
+    h = _display_dirty_y1 > y ? _display_dirty_y1 - y : 0;
+    _display_dirty_x0 = _display_dirty_x1 = 0;
+    _display_dirty_y0 = _display_dirty_y1 = 0;
+    taskEXIT_CRITICAL();
+    
+    if (w && h)
+    {
+        hw_display_start_frame(x, y, w, h);
     
-    // block wait for the draw to finish
-    // this is invoked via the ISR
-    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // block wait for the draw to finish
+        // this is invoked via the ISR
+        uint32_t start = display_stat_timestamp();
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        display_stat_record(DisplayStatWait, display_stat_elapsed_us(start));
+        _display_counts.sent++;
+    }
     
     // unlock the mutex
     xSemaphoreGive(_display_mutex);
@@ -83,63 +215,371 @@ static void _display_start_frame(uint8_t xoffset, uint8_t yoffset)
 
 /*
  * Get the pointer t the back buffer
+ * With double buffering this changes every display_draw
  */
 uint8_t *display_get_buffer(void)
 {
+#ifdef DISPLAY_DOUBLE_BUFFER
+    return _display_back;
+#else
     return hw_display_get_buffer();
+#endif
+}
+
+#ifdef DISPLAY_DOUBLE_BUFFER
+/*
+ * Make the freshly drawn back buffer the one to send
+ * Waits for any frame in flight to finish first
+ */
+static void _display_flip(void)
+{
+    uint8_t *drawn = _display_back;
+    
+    xSemaphoreTake(_display_mutex, portMAX_DELAY);
+    
+    // the front buffer was waiting to go out and now never will
+    if (_display_pending)
+        _display_counts.dropped++;
+    
+    _display_back = _display_front;
+    _display_front = drawn;
+    hw_display_set_buffer(_display_front);
+    
+    xSemaphoreGive(_display_mutex);
+}
+#endif
+
+/*
+ * Ask the display thread for a frame. If one is already waiting
+ * this one is folded into it
+ */
+static void _display_request_frame(void)
+{
+    taskENTER_CRITICAL();
+    _display_counts.requested++;
+    if (_display_pending)
+        _display_counts.coalesced++;
+    _display_pending = 1;
+    taskEXIT_CRITICAL();
+    
+    // binary, so giving it again while it is still set does nothing
+    xSemaphoreGive(_display_request);
+}
+
+/*
+ * Get a copy of the frame counters
+ */
+void display_get_frame_counts(DisplayFrameCounts *counts)
+{
+    taskENTER_CRITICAL();
+    *counts = _display_counts;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Start the cycle counter, and check it actually counts
+ */
+static void _display_stat_init(void)
+{
+    uint32_t start;
+    
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    
+    start = DWT->CYCCNT;
+    for (volatile int i = 0; i < 10; i++)
+        ;
+    _display_stat_cycles = DWT->CYCCNT != start;
+    _display_stat_cycles_per_us = SystemCoreClock / 1000000;
+}
+
+/*
+ * A timestamp to measure from. Safe to call from an ISR
+ */
+uint32_t display_stat_timestamp(void)
+{
+    if (_display_stat_cycles)
+        return DWT->CYCCNT;
+    
+    return xTaskGetTickCountFromISR();
+}
+
+/*
+ * Microseconds since the given timestamp
+ */
+uint32_t display_stat_elapsed_us(uint32_t since)
+{
+    uint32_t delta = display_stat_timestamp() - since;
+    
+    if (_display_stat_cycles)
+        return delta / _display_stat_cycles_per_us;
+    
+    return delta * portTICK_PERIOD_MS * 1000;
+}
+
+/*
+ * Add a sample to one of the pipeline histograms. Safe to call from an ISR
+ */
+void display_stat_record(DisplayStat stat, uint32_t value)
+{
+    DisplayStatHistogram *hist = &_display_stats[stat];
+    uint8_t bucket = 0;
+    UBaseType_t mask;
+    
+    while (bucket < DISPLAY_STAT_BUCKETS - 1 && (value >> bucket))
+        bucket++;
+    
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    hist->count++;
+    hist->total += value;
+    if (value > hist->max)
+        hist->max = value;
+    hist->buckets[bucket]++;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+/*
+ * Get a copy of one of the pipeline histograms
+ */
+void display_get_stats(DisplayStat stat, DisplayStatHistogram *hist)
+{
+    taskENTER_CRITICAL();
+    *hist = _display_stats[stat];
+    taskEXIT_CRITICAL();
 }
 
 /*
- * Request a command from the display driver. 
- * Such as DISPLAY_CMD_DRAW
+ * Start all the pipeline histograms again
  */
-static void _display_cmd(uint8_t cmd, char *data)
+void display_reset_stats(void)
 {
-    xQueueSendToBack(_display_queue, &cmd, 0);
+    taskENTER_CRITICAL();
+    memset(_display_stats, 0, sizeof(_display_stats));
+    taskEXIT_CRITICAL();
 }
 
 /*
- * Queue a draw when available
+ * Dump the frame counters and pipeline histograms to the log
+ */
+void display_log_stats(void)
+{
+    static const char *names[DisplayStatMax] = {
+        [DisplayStatRender]   = "render us",
+        [DisplayStatConvert]  = "convert us",
+        [DisplayStatTransfer] = "transfer us",
+        [DisplayStatWait]     = "wait us",
+        [DisplayStatIsrs]     = "isrs",
+        [DisplayStatSkipped]  = "skipped %",
+        [DisplayStatOverdraw] = "overdraw saved %",
+    };
+    DisplayFrameCounts counts;
+    DisplayStatHistogram hist;
+    uint32_t *b;
+    
+    display_get_frame_counts(&counts);
+    KERN_LOG("Display", APP_LOG_LEVEL_DEBUG, "frames: req %d coalesced %d dropped %d sent %d",
+             counts.requested, counts.coalesced, counts.dropped, counts.sent);
+    
+    // log lines are short, so the buckets go out eight at a time
+    for (uint8_t i = 0; i < DisplayStatMax; i++)
+    {
+        display_get_stats(i, &hist);
+        b = hist.buckets;
+        
+        KERN_LOG("Display", APP_LOG_LEVEL_DEBUG, "%s: n %d avg %d max %d",
+                 names[i], hist.count, hist.count ? hist.total / hist.count : 0, hist.max);
+        KERN_LOG("Display", APP_LOG_LEVEL_DEBUG, " <2^0..7: %d %d %d %d %d %d %d %d",
+                 b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7]);
+        KERN_LOG("Display", APP_LOG_LEVEL_DEBUG, " <2^8..15: %d %d %d %d %d %d %d %d",
+                 b[8], b[9], b[10], b[11], b[12], b[13], b[14], b[15]);
+    }
+}
+
+/*
+ * Queue a draw of the whole screen when available
  */
 void display_draw(void)
 {
-    _display_cmd(DISPLAY_CMD_DRAW, 0);
+    display_draw_rect(0, 0, DISPLAY_COLS, DISPLAY_ROWS);
+}
+
+/*
+ * Queue a draw when available. Only the given area has changed,
+ * so that is all the driver needs to send. Areas from draws that
+ * have not gone out yet are merged in
+ */
+void display_draw_rect(int16_t x, int16_t y, int16_t width, int16_t height)
+{
+#ifdef DISPLAY_DOUBLE_BUFFER
+    _display_flip();
+#endif
+    // after the flip, so the area is never sent from the old buffer
+    _display_mark_dirty(x, y, width, height);
+    _display_request_frame();
 }
 
 /*
  * Main task processing for the display. Manages locking
- * state machine control and command management
+ * and sends whatever frame is waiting
  */
 static void _display_thread(void *pvParameters)
 {
-    uint8_t data;
     const TickType_t max_block_time = pdMS_TO_TICKS(1000);
+    uint32_t stats_logged = 0;
 
     // XXX Assume once screen is up, we are up.
     rebbleos_set_system_status(SYSTEM_STATUS_STARTED);
     
     while(1)
     {
-        // commands to be executed are send to this queue and processed
-        // one at a time
-        if (xQueueReceive(_display_queue, &data, max_block_time))
+        if (xSemaphoreTake(_display_request, max_block_time))
         {
-            switch(data)
+            // all we are responsible for is starting a frame draw
+            _display_start_frame();
+            
+            // let the app know, so it can pace itself to the display
+            appmanager_post_draw_done_message();
+            
+#if DISPLAY_STATS_LOG_FRAMES
+            // out here so a flip isn't held up while it logs
+            if (_display_counts.sent && _display_counts.sent != stats_logged &&
+                _display_counts.sent % DISPLAY_STATS_LOG_FRAMES == 0)
             {
-                // in the case of draw, we are going to leave locking to
-                // the outer laters. If someone calls an overlapping draw into here
-                // it's just going to fail
-                case DISPLAY_CMD_DRAW:
-                    // all we are responsible for is starting a frame draw
-                    _display_start_frame(0, 0);
-                    break;
-                case DISPLAY_CMD_DONE:
-                    break;
+                stats_logged = _display_counts.sent;
+                display_log_stats();
             }
+#endif
+            
+            if (_snapshot_stream)
+                display_snapshot(0);
         }
         else
         {
-            // nothing emerged from the buffer
+            // nothing to draw
         }        
     }
 }
+
+/*
+ * Run length encode a row for a snapshot. A control byte below 0x80 is
+ * followed by that many plus one literal bytes. From 0x80 up the next
+ * byte repeats (control - 0x80 + 2) times
+ */
+static uint16_t _snapshot_rle(uint8_t *out, const uint8_t *in, uint16_t len)
+{
+    uint16_t i = 0, o = 0, run;
+    
+    while (i < len)
+    {
+        run = 1;
+        while (i + run < len && run < 129 && in[i + run] == in[i])
+            run++;
+        
+        if (run > 1)
+        {
+            out[o++] = 0x80 + run - 2;
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+        
+        // literals up to the next repeat
+        run = 0;
+        while (i + run < len && run < 128 &&
+               !(i + run + 1 < len && in[i + run] == in[i + run + 1]))
+            run++;
+        
+        out[o++] = run - 1;
+        memcpy(out + o, in + i, run);
+        o += run;
+        i += run;
+    }
+    
+    return o;
+}
+
+/*
+ * Write what is on screen to the debug port. Only rows that changed since
+ * the last snapshot go out, unless keyframe is set. The first one, and
+ * every SNAPSHOT_KEYFRAME_INTERVAL'th after, is always a keyframe.
+ * Output looks like
+ *   @S seq width height row_bytes bpp keyframe
+ *   @R row rle_hex
+ *   @E seq rows_written
+ *
+ * The display is only held while each row is copied out, not while it
+ * is printed. A flip part way through can leave a snapshot with rows
+ * from both frames; the rows from the newer one count as sent, so the
+ * next snapshot puts the rest right.
+ */
+void display_snapshot(uint8_t keyframe)
+{
+    static uint8_t row[SNAPSHOT_ROW_BYTES];
+    static uint8_t rle[SNAPSHOT_RLE_MAX];
+    static char hex[SNAPSHOT_RLE_MAX * 2 + 1];
+    const char *digits = "0123456789abcdef";
+    uint8_t *fb;
+    uint32_t hash;
+    uint16_t len, rows = 0;
+    
+    xSemaphoreTake(_snapshot_mutex, portMAX_DELAY);
+    
+    if (_snapshot_seq % SNAPSHOT_KEYFRAME_INTERVAL == 0)
+        keyframe = 1;
+    
+    log_clock_enable();
+    printf("@S %d %d %d %d %d %d\n", _snapshot_seq, DISPLAY_COLS, DISPLAY_ROWS,
+           SNAPSHOT_ROW_BYTES, SNAPSHOT_BPP, keyframe);
+    
+    for (uint16_t y = 0; y < DISPLAY_ROWS; y++)
+    {
+        // hold off any flip while the row is copied
+        xSemaphoreTake(_display_mutex, portMAX_DELAY);
+#ifdef DISPLAY_DOUBLE_BUFFER
+        fb = _display_front;
+#else
+        fb = hw_display_get_buffer();
+#endif
+#ifdef DISPLAY_NATIVE_FRAMEBUFFER
+        // drawn in the display's column layout, so gather the row back out
+        scanline_native_get_row(row, fb, y);
+#else
+        memcpy(row, fb + y * SNAPSHOT_ROW_BYTES, SNAPSHOT_ROW_BYTES);
+#endif
+        xSemaphoreGive(_display_mutex);
+        
+        // FNV-1a
+        hash = 2166136261u;
+        for (uint16_t x = 0; x < SNAPSHOT_ROW_BYTES; x++)
+            hash = (hash ^ row[x]) * 16777619u;
+        
+        if (!keyframe && hash == _snapshot_hash[y])
+            continue;
+        _snapshot_hash[y] = hash;
+        
+        len = _snapshot_rle(rle, row, SNAPSHOT_ROW_BYTES);
+        for (uint16_t i = 0; i < len; i++)
+        {
+            hex[i * 2] = digits[rle[i] >> 4];
+            hex[i * 2 + 1] = digits[rle[i] & 0xF];
+        }
+        hex[len * 2] = 0;
+        
+        printf("@R %d %s\n", y, hex);
+        rows++;
+    }
+    
+    printf("@E %d %d\n", _snapshot_seq, rows);
+    log_clock_disable();
+    _snapshot_seq++;
+    
+    xSemaphoreGive(_snapshot_mutex);
+}
+
+/*
+ * Take a snapshot after every frame sent
+ */
+void display_snapshot_stream(uint8_t enabled)
+{
+    _snapshot_stream = enabled;
+}
@@ -25,9 +25,51 @@
 #endif
 
 
+/* Frame request accounting. See display_get_frame_counts */
+typedef struct DisplayFrameCounts {
+    uint32_t requested; // draws asked for
+    uint32_t coalesced; // draws merged into one that was already waiting
+    uint32_t dropped;   // flipped frames replaced before they were sent
+    uint32_t sent;      // frames that made it to the display
+} DisplayFrameCounts;
+
+/* Display pipeline timing. See display_get_stats */
+typedef enum DisplayStat {
+    DisplayStatRender,   // window_draw, us
+    DisplayStatConvert,  // scanline conversion per frame, us
+    DisplayStatTransfer, // first DMA kick to frame done, us
+    DisplayStatWait,     // display thread blocked on the frame, us
+    DisplayStatIsrs,     // DMA interrupts taken per frame
+    DisplayStatSkipped,  // % of changed lines found the same and not converted
+    DisplayStatOverdraw, // % of deferred drawing culled as covered (RENDER_DEFERRED)
+    DisplayStatMax
+} DisplayStat;
+
+// bucket 0 counts zeros, bucket n counts values in [2^(n-1), 2^n)
+// and the last bucket takes everything bigger
+#define DISPLAY_STAT_BUCKETS 16
+
+typedef struct DisplayStatHistogram {
+    uint32_t count;
+    uint32_t total;
+    uint32_t max;
+    uint32_t buckets[DISPLAY_STAT_BUCKETS];
+} DisplayStatHistogram;
+
 void display_init(void);
 void display_done_ISR(uint8_t cmd);
 void display_reset(uint8_t enabled);
 void display_draw(void);
+void display_draw_rect(int16_t x, int16_t y, int16_t width, int16_t height);
+void display_get_frame_counts(DisplayFrameCounts *counts);
 uint8_t *display_get_buffer(void);
 
+uint32_t display_stat_timestamp(void);
+uint32_t display_stat_elapsed_us(uint32_t since);
+void display_stat_record(DisplayStat stat, uint32_t value);
+void display_get_stats(DisplayStat stat, DisplayStatHistogram *hist);
+void display_reset_stats(void);
+void display_log_stats(void);
+
+void display_snapshot(uint8_t keyframe);
+void display_snapshot_stream(uint8_t enabled);
@@ -10,6 +10,7 @@
 #include "flash.h"
 #include "png.h"
 #include "ngfxwrap.h"
+#include "utils.h"
 
 extern uint8_t *resource_fully_load_id_app(uint16_t, const struct file *file);
 
@@ -93,19 +94,21 @@ void _gbitmap_draw(GBitmap *bitmap, GRect clipping_bounds)
     int16_t newx = bitmap->bounds.origin.x;
     int16_t newy = bitmap->bounds.origin.y + clip_y;
 
-    for(int y = 0; y < h; y++)
+    // trim the loops to the context's clip once rather than per pixel
+    n_GContext *ctx = rwatch_neographics_get_global_context();
+    int16_t x_start = MAX(clip_x, ctx->clip.origin.x - newx);
+    int16_t x_end = MIN((int16_t)w, ctx->clip.origin.x + ctx->clip.size.w - newx);
+    int16_t y_start = MAX(0, ctx->clip.origin.y - newy);
+    int16_t y_end = MIN((int16_t)h, ctx->clip.origin.y + ctx->clip.size.h - newy);
+
+    for(int y = y_start; y < y_end; y++)
     {
         uint32_t bitmap_row_start = (y + clip_y) * bitmap->row_size_bytes;
 
         GColor argb;
         
-        for(int x = clip_x; x < w; x++)
+        for(int x = x_start; x < x_end; x++)
         {   
-            /* XXX: Replace with more efficient bounds checking later. */         
-            if (((x + newx) < 0) || ((x + newx) >= DISPLAY_COLS) ||
-                ((y + newy) < 0) || ((y + newy) >= DISPLAY_ROWS))
-                continue;
-            
             if (bitmap->format == GBitmapFormat2BitPalette)
             {
                 // shift the bits according to their position mod
@@ -119,7 +122,6 @@ void _gbitmap_draw(GBitmap *bitmap, GRect clipping_bounds)
                 if (bitmap->palette[pal_idx].a > 0)
                 {
                     argb = bitmap->palette[pal_idx];
-                    // TODO compositing
                 }
                 else
                 {
@@ -180,10 +182,10 @@ void _gbitmap_draw(GBitmap *bitmap, GRect clipping_bounds)
                     argb = GColorBlack;
             }
             
-            // set the pixel in the buffer.
+            // set the pixel in the buffer, translucent colors are
+            // composited over what's there
             if (argb.argb > 0)
             {
-                n_GContext *ctx = rwatch_neographics_get_global_context();
                 n_graphics_set_pixel(ctx, n_GPoint(x + newx, y + newy), argb);
             }
         }
@@ -12,12 +12,12 @@
 
 GRect _jimmy_layer_offset(n_GContext *ctx, n_GRect rect)
 {
-    // jimmy the offsets for the layer before we ask ngfx to draw it
+    // jimmy the offsets for the layer before we ask ngfx to draw it.
+    // The layer's clip keeps it inside the layer, so only translate.
     return (GRect) {
         .origin.x = rect.origin.x + ctx->offset.origin.x,
         .origin.y = rect.origin.y + ctx->offset.origin.y, 
-        .size.w = (rect.size.w > ctx->offset.size.w ? ctx->offset.size.w : rect.size.w), 
-        .size.h = (rect.size.h > ctx->offset.size.h ? ctx->offset.size.h : rect.size.h), 
+        .size = rect.size,
     };
 }
 
@@ -81,10 +81,26 @@ void graphics_draw_rect(n_GContext * ctx, n_GRect rect, uint16_t radius, n_GCorn
     n_graphics_draw_rect(ctx, _jimmy_layer_offset(ctx, rect), radius, mask);
 }
 
+void graphics_draw_arc(n_GContext * ctx, n_GRect rect, n_GOvalScaleMode scale_mode,
+                       int32_t angle_start, int32_t angle_end)
+{
+    n_graphics_draw_arc(ctx, _jimmy_layer_offset(ctx, rect), scale_mode,
+                        angle_start, angle_end);
+}
+
+void graphics_fill_radial(n_GContext * ctx, n_GRect rect, n_GOvalScaleMode scale_mode,
+                          uint16_t inset_thickness, int32_t angle_start, int32_t angle_end)
+{
+    n_graphics_fill_radial(ctx, _jimmy_layer_offset(ctx, rect), scale_mode,
+                           inset_thickness, angle_start, angle_end);
+}
+
 
 
 GBitmap *graphics_capture_frame_buffer(n_GContext *context)
 {
+    // the app is about to touch pixels itself, so draw anything deferred
+    n_graphics_context_flush(context);
     // TODO Honestly not entirely sure what is expected here
     // rbl_lock_frame_buffer
     return (GBitmap *)display_get_buffer();
@@ -92,6 +108,8 @@ GBitmap *graphics_capture_frame_buffer(n_GContext *context)
 
 GBitmap *graphics_capture_frame_buffer_format(n_GContext *context, GBitmap format)
 {
+    // the app is about to touch pixels itself, so draw anything deferred
+    n_graphics_context_flush(context);
     // TODO Honestly not entirely sure what is expected here
     // rbl_lock_frame_buffer
     return (GBitmap *)display_get_buffer();
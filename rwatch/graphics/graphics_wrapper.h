@@ -14,4 +14,10 @@ void graphics_draw_text(
 void graphics_draw_bitmap_in_rect(GContext *ctx, GBitmap *bitmap, GRect rect);
 void graphics_draw_pixel(n_GContext * ctx, n_GPoint p);
 void graphics_draw_rect(n_GContext * ctx, n_GRect rect, uint16_t radius, n_GCornerMask mask);
+// Firmware only for now, not in the app jump table (api_func_symbols.h)
+// until their SDK slots are known. Apps calling them still hit an unalloc stub
+void graphics_draw_arc(n_GContext * ctx, n_GRect rect, n_GOvalScaleMode scale_mode,
+                       int32_t angle_start, int32_t angle_end);
+void graphics_fill_radial(n_GContext * ctx, n_GRect rect, n_GOvalScaleMode scale_mode,
+                          uint16_t inset_thickness, int32_t angle_start, int32_t angle_end);
 GBitmap *graphics_capture_frame_buffer(n_GContext *context);
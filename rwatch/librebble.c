@@ -18,3 +18,8 @@ void rbl_draw(void)
 {
     display_draw();
 }
+
+void rbl_draw_rect(GRect rect)
+{
+    display_draw_rect(rect.origin.x, rect.origin.y, rect.size.w, rect.size.h);
+}
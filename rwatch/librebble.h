@@ -44,4 +44,5 @@
 #include "app_timer.h"
 
 void rbl_draw(void);
+void rbl_draw_rect(GRect rect);
 struct tm *rbl_get_tm(void);
@@ -8,6 +8,11 @@
 
 #include "context.h"
 
+// Have window_draw record each frame and rasterize it a band at a time,
+// skipping whatever later opaque fills cover (see neographics deferred.h).
+// The display list takes about 2.5kB of kernel heap, so it is off by default.
+// #define RENDER_DEFERRED
+
 void rwatch_neographics_init(void);
 n_GContext *rwatch_neographics_get_global_context(void);
     
\ No newline at end of file
@@ -123,5 +123,9 @@
 
 #define GCornerNone n_GCornerNone
 
+#define GOvalScaleMode n_GOvalScaleMode
+#define GOvalScaleModeFitCircle n_GOvalScaleModeFitCircle
+#define GOvalScaleModeFillCircle n_GOvalScaleModeFillCircle
+
 #define graphics_context_set_text_color n_graphics_context_set_text_color
 #include "gbitmap.h"
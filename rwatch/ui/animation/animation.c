@@ -12,6 +12,11 @@
 
 #define ANIMATION_FPS 30
 #define ANIMATION_TICKS (pdMS_TO_TICKS(1000) / ANIMATION_FPS)
+/* Animations step when the display finishes a frame, but no faster than this */
+#define ANIMATION_MAX_FPS 60
+#define ANIMATION_MIN_TICKS (pdMS_TO_TICKS(1000) / ANIMATION_MAX_FPS)
+/* How long to wait for a frame we asked for before stepping anyway */
+#define ANIMATION_FRAME_TIMEOUT pdMS_TO_TICKS(250)
 
 /* XXX: The memory allocation story here is kind of a mess.  We do an
  * app_malloc on this, and store a bunch of state in the application's
@@ -86,6 +91,13 @@ void _animation_update(Animation *anim)
     
     if (anim->impl.update)
         anim->impl.update(anim, (uint32_t) progress);
+    anim->lastticks = now;
+    
+    /* If the update drew something, animation_frame_done will step us
+     * once it is on the display. Only fall back to the timer if it never is */
+    Window *wind = window_stack_get_top_window();
+    if (wind && wind->is_render_scheduled)
+        anim->timer.when = now + ANIMATION_FRAME_TIMEOUT;
     
     anim->onqueue = 1;
     appmanager_timer_add(&anim->timer);
@@ -99,6 +111,52 @@ void _anim_callback(CoreTimer *timer)
     _animation_update(anim);
 }
 
+/*
+ * The display just finished a frame. Bring every waiting animation
+ * forward so they run at the rate the display can actually manage
+ */
+void animation_frame_done(void)
+{
+    app_running_thread *_this_thread = appmanager_get_current_thread();
+    CoreTimer **tnext = &_this_thread->timer_head;
+    CoreTimer *ready = NULL;
+    CoreTimer *timer;
+    TickType_t now = xTaskGetTickCount();
+    TickType_t when;
+    
+    /* pull them out first. Changing when breaks the list ordering */
+    while (*tnext)
+    {
+        timer = *tnext;
+        if (timer->callback != _anim_callback)
+        {
+            tnext = &timer->next;
+            continue;
+        }
+        
+        when = ((Animation *)timer)->lastticks + ANIMATION_MIN_TICKS;
+        if (when < now)
+            when = now;
+        
+        if (timer->when > when)
+        {
+            *tnext = timer->next;
+            timer->when = when;
+            timer->next = ready;
+            ready = timer;
+            continue;
+        }
+        tnext = &timer->next;
+    }
+    
+    while (ready)
+    {
+        timer = ready;
+        ready = timer->next;
+        appmanager_timer_add(timer);
+    }
+}
+
 bool animation_schedule(Animation *anim)
 {
     SYS_LOG("animation", APP_LOG_LEVEL_INFO, "animation scheduled");
@@ -57,6 +57,7 @@ typedef struct Animation
     int onqueue;
     TickType_t duration;
     TickType_t startticks;
+    TickType_t lastticks; /* when update was last called */
     AnimationImplementation impl;
     struct AnimationHandler *anim_handlers;
 } Animation;
@@ -76,6 +77,7 @@ void animation_ctor(Animation* animation);
 bool animation_destroy(Animation *animation);
 void animation_dtor(Animation* animation);
 Animation *animation_clone(Animation *from);
+void animation_frame_done(void);
 Animation *animation_sequence_create(Animation *animation_a, Animation *animation_b, Animation *animation_c, ...);
 Animation *animation_sequence_create_from_array(Animation ** animation_array, uint32_t array_len);
 Animation *animation_spawn_create(Animation *animation_a, Animation *animation_b, Animation *animation_c, ...);
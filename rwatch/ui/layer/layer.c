@@ -11,8 +11,24 @@
 static void _layer_remove_node(Layer *to_be_removed);
 static void _layer_insert_node(Layer *layer_to_insert, Layer *sibling_layer, bool below);
 static void _layer_delete_tree(Layer *layer);
+/*
+ * Mark the frame of a layer and all of its children dirty
+ * origin is the screen position of the parent
+ */
+static void _layer_mark_dirty_area(const Layer *layer, GPoint origin)
+{
+    origin.x += layer->frame.origin.x;
+    origin.y += layer->frame.origin.y;
+    
+    window_dirty_rect(GRect(origin.x, origin.y, layer->frame.size.w, layer->frame.size.h));
+    
+    for (const Layer *child = layer->child; child; child = child->sibling)
+        _layer_mark_dirty_area(child, origin);
+}
+
 static Layer *_layer_find_parent(Layer *orig_layer, Layer *layer);
 static void _layer_walk(/*const*/ Layer *layer, GContext *context);
+static void _layer_mark_dirty_area(const Layer *layer, GPoint origin);
 
 // Layer Functions
 Layer *layer_create(GRect frame)
@@ -87,6 +103,7 @@ void layer_add_child(Layer *parent_layer, Layer *child_layer)
         parent_layer->child = child_layer;
         child_layer->parent = parent_layer;
         child_layer->window = parent_layer->window;
+        layer_mark_dirty(child_layer);
         return;
     }
     
@@ -107,13 +124,25 @@ void layer_add_child(Layer *parent_layer, Layer *child_layer)
     child_layer->parent = parent_layer;
     child_layer->window = parent_layer->window;
 
-    layer_mark_dirty(parent_layer);
+    layer_mark_dirty(child_layer);
 }
 
+/*
+ * Schedule a redraw. Only the screen area under the layer
+ * and its children will be sent to the display
+ */
 void layer_mark_dirty(Layer *layer)
 {
-    //layer->window
-    window_dirty(true);
+    GPoint origin = GPoint(0, 0);
+    
+    // children are offset by the frames of all of their parents
+    for (const Layer *parent = layer->parent; parent; parent = parent->parent)
+    {
+        origin.x += parent->frame.origin.x;
+        origin.y += parent->frame.origin.y;
+    }
+    
+    _layer_mark_dirty_area(layer, origin);
 }
 
 void layer_set_bounds(Layer *layer, GRect bounds)
@@ -156,6 +185,8 @@ void layer_set_bounds_origin(Layer* layer, GPoint origin) {
 void layer_set_frame(Layer *layer, GRect frame)
 {
     if (!RECT_EQ(layer->frame, frame)) {
+        // where we were needs clearing as well as where we are going
+        layer_mark_dirty(layer);
         layer->frame = frame;
         layer_mark_dirty(layer);
     }
@@ -173,6 +204,8 @@ struct Window *layer_get_window(const Layer *layer)
 
 void layer_remove_from_parent(Layer *child)
 {
+    if (child->parent)
+        layer_mark_dirty(child);
     _layer_remove_node(child);
 }
 
@@ -193,6 +226,8 @@ void layer_insert_above_sibling(Layer *layer_to_insert, Layer *above_sibling_lay
 
 void layer_set_hidden(Layer *layer, bool hidden)
 {
+    if (layer->hidden != hidden)
+        layer_mark_dirty(layer);
     layer->hidden = hidden;
 }
 
@@ -210,8 +245,7 @@ void layer_apply_frame_offset(const Layer *layer, GContext *context)
 {
     context->offset.origin.x += layer->frame.origin.x;
     context->offset.origin.y += layer->frame.origin.y;
-    context->offset.size.w = MAX(0, context->offset.size.w - layer->frame.origin.x);
-    context->offset.size.h = MAX(0, context->offset.size.h - layer->frame.origin.y);
+    context->offset.size = layer->frame.size;
 }
 
 /* Private functions */
@@ -279,6 +313,8 @@ static void _layer_walk(/*const*/ Layer *layer, GContext *context)
         {
             GRect previous_offset = context->offset;
             layer_apply_frame_offset(layer, context);
+            // neither the layer nor its children draw outside its frame
+            n_graphics_context_push_clip(context, context->offset);
 
             if (layer->update_proc)
                 layer->update_proc(layer, context);
@@ -286,6 +322,7 @@ static void _layer_walk(/*const*/ Layer *layer, GContext *context)
             // walk this elements sub elements recursively before moving on to the next element
             _layer_walk(layer->child, context);
 
+            n_graphics_context_pop_clip(context);
             context->offset = previous_offset; // restore offset
         }
         _layer_walk(layer->sibling, context);
@@ -410,9 +410,11 @@ static void menu_layer_update_proc(Layer *layer, GContext *nGContext)
 
         GRect offset = nGContext->offset;
         layer_apply_frame_offset(layer, nGContext);
+        n_graphics_context_push_clip(nGContext, nGContext->offset);
 
         menu_layer_draw_cell(nGContext, menu_layer, span, layer);
 
+        n_graphics_context_pop_clip(nGContext);
         nGContext->offset = offset;
     }
 
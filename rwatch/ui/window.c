@@ -8,6 +8,7 @@
 #include "librebble.h"
 #include "ngfxwrap.h"
 #include "node_list.h"
+#include "utils.h"
 
 static list_head _window_list_head = LIST_HEAD(_window_list_head);
 
@@ -233,6 +234,7 @@ Layer *window_get_root_layer(Window *window)
 
 /*
  * Invalidate the window so it is scheduled for a redraw
+ * The whole screen is sent to the display
  */
 void window_dirty(bool is_dirty)
 {
@@ -241,6 +243,9 @@ void window_dirty(bool is_dirty)
     if (wind == NULL)
         return;
     
+    if (is_dirty)
+        wind->dirty_rect = GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS);
+    
     if (wind->is_render_scheduled != is_dirty)
     {
         wind->is_render_scheduled = is_dirty;
@@ -250,6 +255,34 @@ void window_dirty(bool is_dirty)
     }
 }
 
+/*
+ * Invalidate part of the window. Everything still gets redrawn, but
+ * only the union of the dirty areas is sent to the display
+ */
+void window_dirty_rect(GRect rect)
+{
+    Window *wind = window_stack_get_top_window();
+    
+    if (wind == NULL || rect.size.w <= 0 || rect.size.h <= 0)
+        return;
+    
+    if (!wind->is_render_scheduled)
+    {
+        wind->dirty_rect = rect;
+        wind->is_render_scheduled = true;
+        appmanager_post_draw_message();
+        return;
+    }
+    
+    int16_t x1 = MAX(wind->dirty_rect.origin.x + wind->dirty_rect.size.w, rect.origin.x + rect.size.w);
+    int16_t y1 = MAX(wind->dirty_rect.origin.y + wind->dirty_rect.size.h, rect.origin.y + rect.size.h);
+    
+    wind->dirty_rect.origin.x = MIN(wind->dirty_rect.origin.x, rect.origin.x);
+    wind->dirty_rect.origin.y = MIN(wind->dirty_rect.origin.y, rect.origin.y);
+    wind->dirty_rect.size.w = x1 - wind->dirty_rect.origin.x;
+    wind->dirty_rect.size.h = y1 - wind->dirty_rect.origin.y;
+}
+
 void window_draw()
 {
     Window *wind = window_stack_get_top_window();
@@ -258,15 +291,36 @@ void window_draw()
         return;
     if (wind && wind->is_render_scheduled)
     {
+        uint32_t start = display_stat_timestamp();
         GContext *context = rwatch_neographics_get_global_context();
         GRect frame = layer_get_frame(wind->root_layer);
+        // the display may have flipped buffers since last time
+        context->fbuf = display_get_buffer();
         context->offset = frame;
+        // start from the whole screen in case a previous draw left clips behind
+        n_graphics_context_reset_clip(context);
         context->fill_color = wind->background_color;
+#ifdef RENDER_DEFERRED
+        bool deferred = n_graphics_context_begin_deferred(context);
+#endif
+        // on round displays the row fills only touch the visible circle
         graphics_fill_rect(context, GRect(0, 0, frame.size.w, frame.size.h), 0, GCornerNone);
         
         layer_draw(wind->root_layer, context);
+#ifdef RENDER_DEFERRED
+        if (deferred)
+        {
+            n_GDeferredStats stats;
+            n_graphics_context_end_deferred(context);
+            n_graphics_context_get_deferred_stats(context, &stats);
+            if (stats.area)
+                display_stat_record(DisplayStatOverdraw,
+                                    (stats.area - stats.drawn) * 100 / stats.area);
+        }
+#endif
+        display_stat_record(DisplayStatRender, display_stat_elapsed_us(start));
         
-        rbl_draw();
+        rbl_draw_rect(wind->dirty_rect);
         wind->is_render_scheduled = false;
     }
 }
@@ -56,6 +56,7 @@ typedef struct Window
     void *user_data;
     GColor background_color;
     bool is_render_scheduled;
+    GRect dirty_rect; // screen area to send on the next draw
     //bool on_screen : 1;
     WindowLoadState load_state;
     //bool overrides_back_button : 1;
@@ -95,6 +96,7 @@ Window * window_stack_get_top_window(void);
 
 void window_configure(Window *window);
 void window_dirty(bool is_dirty);
+void window_dirty_rect(GRect rect);
 void window_draw();
 
 uint16_t window_count(void);